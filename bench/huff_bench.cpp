@@ -0,0 +1,336 @@
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include "FGKTree.hpp"
+#include "ArrayFGKTree.hpp"
+#include "VitterTree.hpp"
+#include "HuffmanEncoder.hpp"
+#include "HuffmanDecoder.hpp"
+#include "MemoryBuffer.hpp"
+
+
+/*
+ * Microbenchmarks for the hot paths of huff: updating the code trees, writing codes from a tree, the bit writer and
+ * reader, whole encodes and decodes in memory, and saving, loading and cloning a tree's state. Each is run over the
+ * bundled corpora (txt/, img/, sound/ and tar/) and over synthetic skewed and uniform inputs, so a change can be seen
+ * per kind of data without the process start and disk I/O that timing whole ./huff runs includes. Besides the time per
+ * iteration, the benchmarks which code symbols report bytes_per_second and ns/symbol (a plain count of nanoseconds),
+ * encodes also report the compressed size as a ratio of the input, and snapshot saves report the snapshot's size as
+ * snapshot_bytes.
+ *
+ * Run from anywhere, the corpora are found in the source tree; pass --benchmark_filter=REGEX to run only some.
+ */
+
+
+
+/*--- INPUTS ---*/
+
+
+
+//the most of each corpus which is used, so that a run stays short
+static const std::size_t CORPUS_LIMIT = 4 << 20;
+static const std::size_t SYNTHETIC_SIZE = 1 << 20;
+
+struct Input {
+    std::string name;
+    std::vector<unsigned char> data;
+};
+
+//concatenate the regular files in a directory of the source tree, up to CORPUS_LIMIT bytes, in name order
+static std::vector<unsigned char> readCorpus(const std::string& directory) {
+    std::vector<unsigned char> data;
+    std::string path = std::string(HUFF_SOURCE_DIR) + "/" + directory;
+    DIR* dir = ::opendir(path.c_str());
+    if (dir == nullptr)
+        return data;
+    std::vector<std::string> names;
+    while (dirent* entry = ::readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name[0] != '.' && name != "README.md")
+            names.push_back(name);
+    }
+    ::closedir(dir);
+    std::sort(names.begin(), names.end());
+    for (const std::string& name : names) {
+        std::ifstream file(path + "/" + name, std::ios::in | std::ios::binary);
+        data.insert(data.end(), std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        if (data.size() >= CORPUS_LIMIT) {
+            data.resize(CORPUS_LIMIT);
+            break;
+        }
+    }
+    return data;
+}
+
+//the inputs to run each benchmark over, a corpus which is missing is left out
+static std::vector<Input> makeInputs() {
+    std::vector<Input> inputs;
+    for (const char* corpus : {"txt", "img", "sound", "tar"}) {
+        Input input = {corpus, readCorpus(corpus)};
+        if (!input.data.empty())
+            inputs.push_back(input);
+    }
+    //a few symbols make up most of the skewed input, as in text, while every symbol is as likely as the rest in the
+    //uniform input, which is the worst case for the trees
+    std::mt19937 random(150013828);
+    std::geometric_distribution<int> skewed(0.15);
+    std::uniform_int_distribution<int> uniform(0, 255);
+    Input skewedInput = {"skewed", std::vector<unsigned char>(SYNTHETIC_SIZE)};
+    Input uniformInput = {"uniform", std::vector<unsigned char>(SYNTHETIC_SIZE)};
+    for (std::size_t i = 0; i < SYNTHETIC_SIZE; i++) {
+        skewedInput.data[i] = static_cast<unsigned char>(std::min(skewed(random), 255));
+        uniformInput.data[i] = static_cast<unsigned char>(uniform(random));
+    }
+    inputs.push_back(skewedInput);
+    inputs.push_back(uniformInput);
+    return inputs;
+}
+
+//report the symbols coded per iteration as bytes_per_second, and the nanoseconds per symbol since start, which is taken
+//just before the benchmark loop. a rate counter would be shown in seconds, so ns/symbol is a plain value
+static void setCounters(benchmark::State& state, std::size_t symbols, std::chrono::steady_clock::time_point start) {
+    double nanoseconds = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    double total = static_cast<double>(state.iterations()) * static_cast<double>(symbols);
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations()) * static_cast<std::int64_t>(symbols));
+    state.counters["ns/symbol"] = total > 0 ? nanoseconds / total : 0;
+}
+
+//make the code tree for a backend name
+static HuffmanTree<unsigned char>* makeTree(const std::string& backend) {
+    if (backend == "vitter")
+        return new VitterTree<unsigned char>();
+    if (backend == "array")
+        return new ArrayFGKTree<unsigned char>();
+    return new FGKTree<unsigned char>();
+}
+
+
+
+/*--- BENCHMARKS ---*/
+
+
+
+//update a new tree with every symbol of the input, as both the encoder and decoder do
+static void treeUpdate(benchmark::State& state, const Input& input, const std::string& backend) {
+    std::unique_ptr<HuffmanTree<unsigned char>> tree(makeTree(backend));
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (auto _ : state) {
+        tree->reset();
+        for (unsigned char c : input.data)
+            tree->update(c);
+        benchmark::DoNotOptimize(tree->getNYTIndex());
+    }
+    setCounters(state, input.data.size(), start);
+}
+
+//write the code of every symbol of the input from a tree already built from the whole input, walking the tree for each
+//code unless the codes are cached
+static void outputPath(benchmark::State& state, const Input& input, bool cached) {
+    FGKTree<unsigned char> tree;
+    for (unsigned char c : input.data)
+        tree.update(c);
+    tree.cacheCodes(cached);
+    std::vector<char> code;
+    code.reserve(input.data.size() * 2);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (auto _ : state) {
+        code.clear();
+        BitWriter<unsigned char> bits(code);
+        for (unsigned char c : input.data)
+            tree.outputPath(c, bits);
+        bits.flush();
+        benchmark::DoNotOptimize(code.data());
+    }
+    setCounters(state, input.data.size(), start);
+}
+
+//write each bit of the input, one at a time
+static void writeBit(benchmark::State& state, const Input& input) {
+    std::vector<char> code;
+    code.reserve(input.data.size());
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (auto _ : state) {
+        code.clear();
+        BitWriter<unsigned char> bits(code);
+        for (unsigned char c : input.data) {
+            for (int i = CHAR_BIT - 1; i >= 0; i--)
+                bits.writeBit((c >> i) & 1);
+        }
+        bits.flush();
+        benchmark::DoNotOptimize(code.data());
+    }
+    setCounters(state, input.data.size(), start);
+}
+
+//read each bit of the input, one at a time
+static void readBit(benchmark::State& state, const Input& input) {
+    const char* data = reinterpret_cast<const char*>(input.data.data());
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (auto _ : state) {
+        BitReader<unsigned char> reader(data, input.data.size());
+        unsigned long ones = 0;
+        for (std::size_t i = 0; i < input.data.size() * CHAR_BIT; i++)
+            ones += reader.read();
+        benchmark::DoNotOptimize(ones);
+    }
+    setCounters(state, input.data.size(), start);
+}
+
+//save a snapshot of a tree built from the whole input into memory, reporting the snapshot's size as snapshot_bytes and
+//the rate it is written at as bytes_per_second
+static void snapshotSave(benchmark::State& state, const Input& input, const std::string& backend) {
+    std::unique_ptr<HuffmanTree<unsigned char>> tree(makeTree(backend));
+    for (unsigned char c : input.data)
+        tree->update(c);
+    std::vector<char> snapshot;
+    VectorOutputBuffer outputBuffer(snapshot);
+    std::ostream out(&outputBuffer);
+    for (auto _ : state) {
+        snapshot.clear();
+        tree->save(out);
+        benchmark::DoNotOptimize(snapshot.data());
+    }
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations()) * static_cast<std::int64_t>(snapshot.size()));
+    state.counters["snapshot_bytes"] = static_cast<double>(snapshot.size());
+}
+
+//load the snapshot of a tree built from the whole input, from memory
+static void snapshotLoad(benchmark::State& state, const Input& input, const std::string& backend) {
+    std::unique_ptr<HuffmanTree<unsigned char>> tree(makeTree(backend));
+    for (unsigned char c : input.data)
+        tree->update(c);
+    std::vector<char> snapshot;
+    VectorOutputBuffer outputBuffer(snapshot);
+    std::ostream out(&outputBuffer);
+    tree->save(out);
+    MemoryBuffer inputBuffer(snapshot.data(), snapshot.size());
+    std::istream in(&inputBuffer);
+    for (auto _ : state) {
+        inputBuffer.assign(snapshot.data(), snapshot.size());
+        in.clear();
+        if (!tree->load(in)) {
+            state.SkipWithError("the snapshot did not load");
+            break;
+        }
+        benchmark::DoNotOptimize(tree->getNYTIndex());
+    }
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations()) * static_cast<std::int64_t>(snapshot.size()));
+}
+
+//clone a tree built from the whole input, as when forking a coder from a warmed up model
+static void treeClone(benchmark::State& state, const Input& input, const std::string& backend) {
+    std::unique_ptr<HuffmanTree<unsigned char>> tree(makeTree(backend));
+    for (unsigned char c : input.data)
+        tree->update(c);
+    for (auto _ : state) {
+        std::unique_ptr<HuffmanTree<unsigned char>> copy(tree->clone());
+        benchmark::DoNotOptimize(copy->getNYTIndex());
+    }
+}
+
+//compress the input into a container in memory with the algorithm
+static void encode(benchmark::State& state, const Input& input, unsigned char algorithm) {
+    MemoryBuffer inputBuffer(reinterpret_cast<const char*>(input.data.data()), input.data.size());
+    std::istream in(&inputBuffer);
+    std::vector<char> compressed;
+    VectorOutputBuffer outputBuffer(compressed);
+    std::ostream out(&outputBuffer);
+    std::unique_ptr<HuffmanTree<unsigned char>> tree(makeTree(algorithm == ContainerHeader::VITTER ? "vitter" : "node"));
+    HuffmanEncoder<unsigned char> encoder(in, out, *tree);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (auto _ : state) {
+        inputBuffer.assign(reinterpret_cast<const char*>(input.data.data()), input.data.size());
+        in.clear();
+        compressed.clear();
+        encoder.reset();
+        encoder.encode(ContainerHeader(algorithm, CHAR_BIT));
+        benchmark::DoNotOptimize(compressed.data());
+    }
+    setCounters(state, input.data.size(), start);
+    state.counters["ratio"] = static_cast<double>(compressed.size()) / static_cast<double>(input.data.size());
+}
+
+//decompress the input, compressed with the algorithm, from memory
+static void decode(benchmark::State& state, const Input& input, unsigned char algorithm) {
+    std::vector<char> compressed;
+    {
+        MemoryBuffer inputBuffer(reinterpret_cast<const char*>(input.data.data()), input.data.size());
+        std::istream in(&inputBuffer);
+        VectorOutputBuffer outputBuffer(compressed);
+        std::ostream out(&outputBuffer);
+        std::unique_ptr<HuffmanTree<unsigned char>> tree(makeTree(algorithm == ContainerHeader::VITTER ? "vitter" : "node"));
+        HuffmanEncoder<unsigned char> encoder(in, out, *tree);
+        encoder.encode(ContainerHeader(algorithm, CHAR_BIT));
+    }
+    MemoryBuffer inputBuffer(compressed.data(), compressed.size());
+    std::istream in(&inputBuffer);
+    std::vector<char> decompressed;
+    decompressed.reserve(input.data.size());
+    VectorOutputBuffer outputBuffer(decompressed);
+    std::ostream out(&outputBuffer);
+    std::unique_ptr<HuffmanTree<unsigned char>> tree(makeTree(algorithm == ContainerHeader::VITTER ? "vitter" : "node"));
+    HuffmanDecoder<unsigned char> decoder(in, out, *tree);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (auto _ : state) {
+        inputBuffer.assign(compressed.data(), compressed.size());
+        in.clear();
+        decompressed.clear();
+        tree->reset();
+        ContainerHeader header;
+        header.read(in);
+        if (!decoder.decode(header)) {
+            state.SkipWithError(decoder.getError().c_str());
+            break;
+        }
+        benchmark::DoNotOptimize(decompressed.data());
+    }
+    setCounters(state, input.data.size(), start);
+}
+
+
+
+/*--- MAIN METHOD --- */
+
+
+
+int main(int argc, char* argv[]) {
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+    //the inputs live until the benchmarks have run, as each benchmark refers to its input
+    static const std::vector<Input> inputs = makeInputs();
+    const std::pair<const char*, unsigned char> algorithms[] = {
+            {"fgk", ContainerHeader::FGK}, {"vitter", ContainerHeader::VITTER}, {"static", ContainerHeader::STATIC}};
+    for (const Input& input : inputs) {
+        for (const char* backend : {"node", "array", "vitter"}) {
+            benchmark::RegisterBenchmark(("tree_update/" + std::string(backend) + "/" + input.name).c_str(),
+                                         treeUpdate, input, std::string(backend));
+            benchmark::RegisterBenchmark(("snapshot/save/" + std::string(backend) + "/" + input.name).c_str(),
+                                         snapshotSave, input, std::string(backend));
+            benchmark::RegisterBenchmark(("snapshot/load/" + std::string(backend) + "/" + input.name).c_str(),
+                                         snapshotLoad, input, std::string(backend));
+            benchmark::RegisterBenchmark(("tree_clone/" + std::string(backend) + "/" + input.name).c_str(),
+                                         treeClone, input, std::string(backend));
+        }
+        benchmark::RegisterBenchmark(("output_path/" + input.name).c_str(), outputPath, input, false);
+        benchmark::RegisterBenchmark(("output_path/cached/" + input.name).c_str(), outputPath, input, true);
+        benchmark::RegisterBenchmark(("bit_writer/write_bit/" + input.name).c_str(), writeBit, input);
+        benchmark::RegisterBenchmark(("bit_reader/read/" + input.name).c_str(), readBit, input);
+        for (const auto& algorithm : algorithms) {
+            benchmark::RegisterBenchmark(("encode/" + std::string(algorithm.first) + "/" + input.name).c_str(),
+                                         encode, input, algorithm.second);
+            benchmark::RegisterBenchmark(("decode/" + std::string(algorithm.first) + "/" + input.name).c_str(),
+                                         decode, input, algorithm.second);
+        }
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
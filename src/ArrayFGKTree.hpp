@@ -0,0 +1,77 @@
+#ifndef DATA_ENCODING_P01_ARRAYFGKTREE_HPP
+#define DATA_ENCODING_P01_ARRAYFGKTREE_HPP
+
+#include "ArrayTree.hpp"
+
+/*
+ * The FGK update procedure (see FGKTree) applied to a code tree stored in flat arrays. Both trees number their nodes the
+ * same way, so they produce exactly the same codes.
+ */
+template<typename T> class ArrayFGKTree : public ArrayTree<T> {
+    typedef typename ArrayTree<T>::index_t index_t;
+    using ArrayTree<T>::weight;
+    using ArrayTree<T>::parent;
+    using ArrayTree<T>::leaf;
+    using ArrayTree<T>::newNode;
+    using ArrayTree<T>::swapNodes;
+    using ArrayTree<T>::incrementWeight;
+    using ArrayTree<T>::getBlockLeader;
+    using ArrayTree<T>::getRootIndex;
+    using ArrayTree<T>::NO_NODE;
+    using ArrayTree<T>::needsRescale;
+public:
+    ArrayFGKTree() : ArrayTree<T>() {
+        this->reset();
+    }
+
+    virtual HuffmanTree<T>* clone() override {
+        return new ArrayFGKTree<T>(*this);
+    }
+
+    virtual void update(T c) override {
+        //if this is the first appearance of symbol
+        if (leaf[c] == NO_NODE) {
+            index_t oldNYT = newNode(c);
+            //the old NYT node leads the new zero weight block, so it can be incremented before the new external node
+            incrementWeight(oldNYT);
+            incrementWeight(oldNYT - 1);
+            if (oldNYT != getRootIndex())
+                swapTowardsRoot(parent[oldNYT]);
+        } else
+            swapTowardsRoot(leaf[c]);
+        if (needsRescale())
+            this->rescale();
+    }
+
+protected:
+    //blocks are made of nodes with equal weight
+    virtual long getKey(index_t node) override {
+        return weight[node];
+    }
+
+private:
+    //Swap this node with the highest node in its weight group, increment its weight value.
+    //Perform this on each node upwards until the root is reached.
+    void swapTowardsRoot(index_t node) {
+        while (node != NO_NODE) {
+            index_t max = getBlockLeader(node);
+            //the block leader is only ever the node's parent when the node's sibling is the NYT node, the parent is
+            //incremented first so that the node then leads the block itself
+            if (max == parent[node]) {
+                incrementWeight(max);
+                incrementWeight(node);
+                node = parent[max];
+                continue;
+            }
+            if (node != max) {
+                swapNodes(node, max);
+                //carry on from the position that the node's contents were moved to
+                node = max;
+            }
+            incrementWeight(node);
+            node = parent[node];
+        }
+    }
+};
+
+#endif //DATA_ENCODING_P01_ARRAYFGKTREE_HPP
@@ -0,0 +1,213 @@
+#ifndef DATA_ENCODING_P01_ARRAYTREE_HPP
+#define DATA_ENCODING_P01_ARRAYTREE_HPP
+
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include "HuffmanTree.hpp"
+#include "Stats.hpp"
+
+/*
+ * A code tree stored as a struct-of-arrays rather than as linked Node objects. Every array is indexed by node number and
+ * preallocated to hold the largest possible tree, so a node is nothing more than its number: swapping two nodes is an
+ * exchange of array entries, and for byte-sized symbols the whole tree is a few KB.
+ *
+ * The children of a node are always consecutively numbered (the sibling property), so only the number of the 0 child
+ * is stored; the 1 child is the number above it.
+ *
+ * The update rule is defined by the implementation class.
+ */
+template<typename T> class ArrayTree : public HuffmanTree<T> {
+public:
+    using HuffmanTree<T>::ALPHABET_SIZE;
+    using HuffmanTree<T>::getMaxNodes;
+    using HuffmanTree<T>::getRootIndex;
+
+    //node numbers fit in 16 bits for byte-sized symbols, wider symbols need 32 bits
+    typedef typename std::conditional<(2 * ALPHABET_SIZE + 1 < 0xFFFF), std::uint16_t, std::uint32_t>::type index_t;
+    //marks a missing node, e.g. the children of a leaf or the leaf of a symbol which has not appeared yet
+    static const index_t NO_NODE = std::numeric_limits<index_t>::max();
+
+    ArrayTree() : HuffmanTree<T>() {
+        weight = std::vector<int>(getMaxNodes(), 0);
+        parent = std::vector<index_t>(getMaxNodes(), NO_NODE);
+        child = std::vector<index_t>(getMaxNodes(), NO_NODE);
+        symbol = std::vector<T>(getMaxNodes(), 0);
+        leaf = std::vector<index_t>(ALPHABET_SIZE, NO_NODE);
+        nyt = getRootIndex();
+    }
+
+    virtual void reset() override {
+        clear();
+        if (preset)
+            build(*preset, presetNYT);
+    }
+
+    virtual void rescale() override {
+        planRescale();
+        build(rescaled, nyt);
+    }
+
+    virtual unsigned long getNYTIndex() override {
+        return nyt;
+    }
+
+    virtual bool isLeaf(unsigned long node) override {
+        return child[node] == NO_NODE;
+    }
+
+    virtual unsigned long getChild(unsigned long node, int bit) override {
+        return child[node] + (bit ? 1 : 0);
+    }
+
+    virtual unsigned long getParent(unsigned long node) override {
+        return parent[node];
+    }
+
+    virtual T getSymbol(unsigned long node) override {
+        return symbol[node];
+    }
+
+    virtual int getWeight(unsigned long node) override {
+        return weight[node];
+    }
+
+    virtual bool hasSymbol(T s) override {
+        return leaf[s] != NO_NODE;
+    }
+
+    virtual unsigned long getLeafIndex(T s) override {
+        return leaf[s];
+    }
+
+protected:
+    using HuffmanTree<T>::resetBlocks;
+    using HuffmanTree<T>::joinBlock;
+    using HuffmanTree<T>::leaveBlock;
+    using HuffmanTree<T>::touch;
+    using HuffmanTree<T>::touchAll;
+    using HuffmanTree<T>::invalidateCodes;
+    using HuffmanTree<T>::needsRescale;
+    using HuffmanTree<T>::planRescale;
+    using HuffmanTree<T>::rescaled;
+    using HuffmanTree<T>::preset;
+    using HuffmanTree<T>::presetNYT;
+
+    //node weights
+    std::vector<int> weight;
+    //the parent of each node, this belongs to the node's position in the tree and so never changes for a given number
+    //(until the tree is rescaled)
+    std::vector<index_t> parent;
+    //the 0 child of each internal node, NO_NODE for leaves
+    std::vector<index_t> child;
+    //the symbol held by each leaf
+    std::vector<T> symbol;
+    //symbol-indexed table of leaves
+    std::vector<index_t> leaf;
+    //the current NYT leaf
+    index_t nyt;
+
+    //return the key which decides the block a node belongs to, see Block
+    virtual long getKey(index_t node) = 0;
+
+    virtual void restore(const typename HuffmanTree<T>::Plan& plan, unsigned long lowest) override {
+        clear();
+        build(plan, lowest);
+    }
+
+    //empty the tree back to the lone root node
+    void clear() {
+        //only the nodes numbered from the NYT node up are in use, so only their symbols need forgetting
+        index_t lowest = nyt;
+        for (unsigned long node = lowest + 1; node <= getRootIndex(); node++) {
+            if (isLeaf(node))
+                leaf[symbol[node]] = NO_NODE;
+        }
+        nyt = getRootIndex();
+        weight[nyt] = 0;
+        parent[nyt] = NO_NODE;
+        child[nyt] = NO_NODE;
+        touchAll();
+        //the root starts alone in its own block
+        resetBlocks(lowest);
+        joinBlock(nyt, getKey(nyt));
+    }
+
+    //make the tree the planned one (see planTree), the NYT node being numbered lowest
+    void build(const typename HuffmanTree<T>::Plan& plan, unsigned long lowest) {
+        nyt = static_cast<index_t>(lowest);
+        for (unsigned long node = lowest; node <= getRootIndex(); node++) {
+            const typename HuffmanTree<T>::PlannedNode& planned = plan[node];
+            weight[node] = planned.weight;
+            symbol[node] = planned.symbol;
+            child[node] = planned.leaf ? NO_NODE : static_cast<index_t>(planned.child);
+            adopt(static_cast<index_t>(node));
+        }
+        touchAll();
+        //join the blocks from the top down, as each node may join the block above it
+        resetBlocks(lowest);
+        for (unsigned long node = getRootIndex() + 1; node-- > lowest;)
+            joinBlock(node, getKey(static_cast<index_t>(node)));
+    }
+
+    //create a new node at the NYT position, the 0 child being the new NYT node, and the 1 child a new external node
+    //holding the symbol. all three nodes are left with zero weight. returns the number of the old NYT node
+    index_t newNode(T s) {
+        index_t old = nyt;
+        index_t external = old - 1;
+        nyt = old - 2;
+        leaveBlock(old);
+        child[old] = nyt;
+        touch(old);
+        parent[external] = old;
+        child[external] = NO_NODE;
+        weight[external] = 0;
+        symbol[external] = s;
+        leaf[s] = external;
+        parent[nyt] = old;
+        child[nyt] = NO_NODE;
+        weight[nyt] = 0;
+        //join the blocks from the top down, as each node may join the block above it
+        joinBlock(old, getKey(old));
+        joinBlock(external, getKey(external));
+        joinBlock(nyt, getKey(nyt));
+        return old;
+    }
+
+    //exchange the contents (the symbol or the subtree) of two nodes of equal weight, the numbers stay where they are
+    void swapNodes(index_t a, index_t b) {
+        HUFF_COUNT(SWAPS, 1);
+        if (child[a] != child[b]) {
+            touch(a);
+            touch(b);
+        }
+        std::swap(child[a], child[b]);
+        std::swap(symbol[a], symbol[b]);
+        adopt(a);
+        adopt(b);
+        invalidateCodes(a);
+        invalidateCodes(b);
+    }
+
+    //increment the weight of a node which leads its block, moving it into the block above
+    void incrementWeight(index_t node) {
+        leaveBlock(node);
+        weight[node]++;
+        joinBlock(node, getKey(node));
+    }
+
+    //point the children (or the leaf table, for a leaf) back at a node whose contents just moved there
+    void adopt(index_t node) {
+        if (child[node] == NO_NODE) {
+            if (node != nyt)
+                leaf[symbol[node]] = node;
+        } else {
+            parent[child[node]] = node;
+            parent[child[node] + 1] = node;
+        }
+    }
+};
+
+template<typename T> const typename ArrayTree<T>::index_t ArrayTree<T>::NO_NODE;
+
+#endif //DATA_ENCODING_P01_ARRAYTREE_HPP
@@ -0,0 +1,296 @@
+#ifndef DATA_ENCODING_P01_ASYNCSTREAM_HPP
+#define DATA_ENCODING_P01_ASYNCSTREAM_HPP
+
+#include <cerrno>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <ios>
+#include <istream>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <thread>
+#include <vector>
+#include <poll.h>
+#include <unistd.h>
+
+/*
+ * A stream buffer reading a file descriptor (such as a pipe) on a thread of its own, a few large buffers ahead of the
+ * reader, so that waiting on the input overlaps with coding it. The buffers are a fixed number and size, so memory use
+ * does not grow with the length of the input. The input cannot be seeked. A failed read is reported once everything read
+ * before it has been, by setting badbit on the stream. The thread waits on the input alongside a pipe of its own, which
+ * the destructor writes to, so that it can be stopped while the input has nothing to read, such as when the reader gives
+ * up on a slow producer part way through.
+ */
+class ReadAheadBuffer : public std::streambuf {
+public:
+    ReadAheadBuffer(int fd, std::size_t size, unsigned count) : fd(fd), buffers(count, std::vector<char>(size)),
+                                                                current(-1), stopping(false), finished(false),
+                                                                failed(false) {
+        //without the pipe, the thread can only be stopped between reads. poll ignores the negative descriptors
+        if (::pipe(wake) != 0)
+            wake[0] = wake[1] = -1;
+        for (unsigned i = 0; i < count; i++)
+            empty.push_back(i);
+        reader = std::thread(&ReadAheadBuffer::work, this);
+    }
+
+    ~ReadAheadBuffer() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        changed.notify_all();
+        if (wake[1] >= 0) {
+            char byte = 0;
+            while (::write(wake[1], &byte, 1) < 0 && errno == EINTR) {}
+        }
+        reader.join();
+        if (wake[0] >= 0) {
+            ::close(wake[0]);
+            ::close(wake[1]);
+        }
+    }
+
+    ReadAheadBuffer(const ReadAheadBuffer&) = delete;
+    ReadAheadBuffer& operator=(const ReadAheadBuffer&) = delete;
+
+protected:
+    virtual int_type underflow() override {
+        std::unique_lock<std::mutex> lock(mutex);
+        //the buffer just read is handed back to be filled again
+        if (current >= 0) {
+            empty.push_back(current);
+            current = -1;
+            changed.notify_all();
+        }
+        changed.wait(lock, [this]() { return finished || !full.empty(); });
+        //the stream catches the exception, setting badbit
+        if (full.empty() && failed)
+            throw std::ios_base::failure("failed to read the input");
+        if (full.empty())
+            return traits_type::eof();
+        current = full.front().first;
+        std::size_t size = full.front().second;
+        full.pop_front();
+        char* begin = buffers[current].data();
+        setg(begin, begin, begin + size);
+        return traits_type::to_int_type(*begin);
+    }
+
+private:
+    int fd;
+    //the pipe written to by the destructor to stop the thread
+    int wake[2];
+    std::vector<std::vector<char>> buffers;
+    //buffers waiting to be filled, and filled buffers (with the number of bytes in them) waiting to be read
+    std::deque<int> empty;
+    std::deque<std::pair<int, std::size_t>> full;
+    //the buffer being read, if any
+    int current;
+    bool stopping, finished, failed;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::thread reader;
+
+    void work() {
+        while (true) {
+            int buffer;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [this]() { return stopping || !empty.empty(); });
+                if (stopping)
+                    return;
+                buffer = empty.front();
+                empty.pop_front();
+            }
+            //fill the whole buffer unless the input ends first, so that the reader sees few large buffers. if the input
+            //has nothing more to read for now, what has been read so far is handed over rather than kept waiting on more
+            std::size_t size = 0;
+            bool more = true, ok = true;
+            while (size < buffers[buffer].size()) {
+                //wait for the input to be ready rather than in read, so that the destructor can stop the wait
+                pollfd fds[2] = {{fd, POLLIN, 0}, {wake[0], POLLIN, 0}};
+                int ready = ::poll(fds, 2, size > 0 ? 0 : -1);
+                if (ready < 0 && errno == EINTR)
+                    continue;
+                if (fds[1].revents != 0)
+                    return;
+                if (ready == 0)
+                    break;
+                ssize_t got = ready < 0 ? -1 : ::read(fd, buffers[buffer].data() + size, buffers[buffer].size() - size);
+                //a read interrupted by a signal is tried again
+                if (got < 0 && errno == EINTR)
+                    continue;
+                if (got <= 0) {
+                    more = false;
+                    ok = got == 0;
+                    break;
+                }
+                size += got;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (size > 0)
+                    full.push_back(std::make_pair(buffer, size));
+                finished = !more;
+                failed = !ok;
+            }
+            changed.notify_all();
+            if (!more)
+                return;
+        }
+    }
+};
+
+/*
+ * A stream buffer writing to a file descriptor (such as a pipe) on a thread of its own, so that the writer can carry on
+ * coding while earlier output is still being written. Like ReadAheadBuffer the buffers are a fixed number and size. A
+ * failed write is reported when the stream is next flushed.
+ */
+class WriteBehindBuffer : public std::streambuf {
+public:
+    WriteBehindBuffer(int fd, std::size_t size, unsigned count) : fd(fd), buffers(count, std::vector<char>(size)),
+                                                                  current(-1), writing(-1), stopping(false), failed(false) {
+        for (unsigned i = 0; i < count; i++)
+            empty.push_back(i);
+        writer = std::thread(&WriteBehindBuffer::work, this);
+    }
+
+    ~WriteBehindBuffer() {
+        sync();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        changed.notify_all();
+        writer.join();
+    }
+
+    WriteBehindBuffer(const WriteBehindBuffer&) = delete;
+    WriteBehindBuffer& operator=(const WriteBehindBuffer&) = delete;
+
+protected:
+    virtual int_type overflow(int_type c) override {
+        if (!next())
+            return traits_type::eof();
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    //hand over the buffer being written, then wait for everything handed over to be written out
+    virtual int sync() override {
+        if (current >= 0 && pptr() > pbase())
+            hand();
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this]() { return full.empty() && writing < 0; });
+        return failed ? -1 : 0;
+    }
+
+private:
+    int fd;
+    std::vector<std::vector<char>> buffers;
+    //buffers free to be written into, and buffers (with the number of bytes in them) waiting to be written out
+    std::deque<int> empty;
+    std::deque<std::pair<int, std::size_t>> full;
+    //the buffer being written into, and the one being written out, if any
+    int current, writing;
+    bool stopping, failed;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::thread writer;
+
+    //hand over the buffer being written into to be written out
+    void hand() {
+        std::lock_guard<std::mutex> lock(mutex);
+        full.push_back(std::make_pair(current, static_cast<std::size_t>(pptr() - pbase())));
+        current = -1;
+        setp(nullptr, nullptr);
+        changed.notify_all();
+    }
+
+    //hand over the buffer being written into (if any), and start on a free one, returns false if writing has failed
+    bool next() {
+        if (current >= 0)
+            hand();
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this]() { return failed || !empty.empty(); });
+        if (failed)
+            return false;
+        current = empty.front();
+        empty.pop_front();
+        char* begin = buffers[current].data();
+        setp(begin, begin + buffers[current].size());
+        return true;
+    }
+
+    void work() {
+        while (true) {
+            std::pair<int, std::size_t> buffer;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [this]() { return stopping || !full.empty(); });
+                if (full.empty())
+                    return;
+                buffer = full.front();
+                full.pop_front();
+                writing = buffer.first;
+            }
+            const char* data = buffers[buffer.first].data();
+            std::size_t size = buffer.second;
+            bool ok = true;
+            while (ok && size > 0) {
+                ssize_t written = ::write(fd, data, size);
+                if (written < 0 && errno == EINTR)
+                    continue;
+                ok = written > 0;
+                if (ok) {
+                    data += written;
+                    size -= written;
+                }
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                empty.push_back(writing);
+                writing = -1;
+                failed = failed || !ok;
+            }
+            changed.notify_all();
+        }
+    }
+};
+
+/*
+ * Standard input read ahead on a thread of its own.
+ */
+class AsyncInput : public std::istream {
+public:
+    //the default is four 1 MiB buffers
+    explicit AsyncInput(int fd = STDIN_FILENO, std::size_t size = 1 << 20, unsigned count = 4)
+            : std::istream(nullptr), buffer(fd, size, count) {
+        rdbuf(&buffer);
+    }
+
+private:
+    ReadAheadBuffer buffer;
+};
+
+/*
+ * Standard output written behind on a thread of its own.
+ */
+class AsyncOutput : public std::ostream {
+public:
+    explicit AsyncOutput(int fd = STDOUT_FILENO, std::size_t size = 1 << 20, unsigned count = 4)
+            : std::ostream(nullptr), buffer(fd, size, count) {
+        rdbuf(&buffer);
+    }
+
+private:
+    WriteBehindBuffer buffer;
+};
+
+#endif //DATA_ENCODING_P01_ASYNCSTREAM_HPP
@@ -2,75 +2,135 @@
 #define DATA_ENCODING_P01_BITREADER_HPP
 
 #include <istream>
+#include <vector>
+#include <cstdint>
 #include <climits>
 
 // A class to represent a buffered bit reader. Similar to BitWriter, but rather than writing to an ostream, this reads
-// bits (buffered, read each byte MSB first, left-to-right) from an istream. The reader will not check for EOF.
-//T_BUFFER is the buffer type used - should be any integral type up to and including long; other types may produce undefined/unexpected behaviour.
+// bits (buffered, read each byte MSB first, left-to-right) from an istream. The reader will not check for EOF, bits
+// read past the end of the input are zero.
+// The input is read into a large byte buffer, which feeds a 64-bit window of upcoming bits. Up to 57 bits can be looked
+// at with peekBits, then passed over with consumeBits, so a whole codeword can be matched without reading bit by bit.
+// The bits may instead be read from bytes already in memory.
+//T_BUFFER is the unit that getCurrentBit and nextBufferGood work in - should be any integral type up to and including long; other types may produce undefined/unexpected behaviour.
 template<typename T_BUFFER> class BitReader {
 public:
     static const int BITS = sizeof(T_BUFFER) * CHAR_BIT;
+    //the most bits that can be peeked at once, the window is refilled a byte at a time so 7 bits of it may be unusable
+    static const unsigned MAX_PEEK = 64 - CHAR_BIT + 1;
+    //the number of bytes read from the input stream at once
+    static const std::size_t BUFFER_SIZE = 1 << 16;
 
-    BitReader(std::istream& input) : input(input) {
+    BitReader(std::istream& input) : input(&input), bytes(BUFFER_SIZE) {
         reset();
+        source = bytes.data();
     }
 
-    //read another bit from the buffer, if the buffer is empty a byte will be read from the input stream
+    //read from size bytes of memory rather than from a stream, the memory must outlive the reader
+    BitReader(const char* data, std::size_t size) : input(nullptr) {
+        reset();
+        source = data;
+        end = size;
+    }
+
+    //read another bit
     int read() {
-        if (current_bit == 0) {
-            //read into the buffer if the bit counter has just started
-            input.read(reinterpret_cast<char*>(&buffer), sizeof(T_BUFFER));
-        }
-        //get the value for a particular bit
-        long index = BITS - current_bit - 1;
-        int bit = (buffer & (1 << index)) >> index;
-        if (++current_bit == BITS) {
-            //reset the bit counter
-            current_bit = 0;
-        }
-        return bit;
+        return static_cast<int>(readBits(1));
     }
 
+    //read a value of type T, msb-first
     template<typename T>
     T read() {
-        T t = 0;
-        for (int i = 0; i < sizeof(T) * CHAR_BIT; i++)
-            t |= (read() << BITS - i - 1);
-        return t;
+        return static_cast<T>(readBits(sizeof(T) * CHAR_BIT));
+    }
+
+    //return the next n bits (n no more than MAX_PEEK) as a number, msb-first, without moving past them
+    std::uint64_t peekBits(unsigned n) {
+        if (n == 0)
+            return 0;
+        if (count < n)
+            refill();
+        return window >> (64 - n);
     }
 
-    //read n bits into c
-    void read(unsigned long n, T_BUFFER& c) {
-        read(n, 0, c);
+    //move past the next n bits, these must have been peeked at first
+    void consumeBits(unsigned n) {
+        //shifting a 64-bit value by 64 is undefined, so n is no more than MAX_PEEK
+        window <<= n;
+        count = count > n ? count - n : 0;
+        consumed += n;
     }
 
-    //read n bits into c, starting from bit i
-    void read(unsigned long n, unsigned long i, T_BUFFER& c) {
-        for (unsigned long j = 0; j < n; j++)
-            c |= (read() << BITS - ((i + j) % BITS) - 1);
+    //read the next n bits as a number, msb-first, n may be anything up to 64
+    std::uint64_t readBits(unsigned n) {
+        if (n > 32) {
+            std::uint64_t high = readBits(n - 32);
+            return (high << 32) | readBits(32);
+        }
+        std::uint64_t bits = peekBits(n);
+        consumeBits(n);
+        return bits;
     }
 
-    //returns true if the input stream is in a good state to get a new buffer from the input
+    //returns true if there is more input after the T_BUFFER currently being read
     bool nextBufferGood() {
-        //peek at the input stream, then tell if it is good or not
-        //todo this likely only works for a single char
-        return input.peek(), input.good();
+        //the bits left in the T_BUFFER currently being read (none if reading has not started on it)
+        unsigned partial = (BITS - getCurrentBit()) % BITS;
+        if (count <= partial)
+            refill();
+        return count > partial;
     }
 
     //return the current bit (zero based) in the buffer
     int getCurrentBit() {
-        return current_bit;
+        return static_cast<int>(consumed % BITS);
+    }
+
+    //return the number of bits consumed so far, including any consumed past the end of the input
+    std::uint64_t getBitsRead() {
+        return consumed;
     }
 
 private:
-    std::istream& input;
-    int current_bit;
-    T_BUFFER buffer;
+    //the input stream, or null when reading from memory
+    std::istream* input;
+    //the upcoming bits, starting at the most significant bit, of which count are valid
+    std::uint64_t window;
+    unsigned count;
+    //the total number of bits consumed, for finding the position within a T_BUFFER
+    std::uint64_t consumed;
+    //bytes read from the input stream, unused when reading from memory
+    std::vector<char> bytes;
+    //the bytes not yet moved into the window are source[next] up to source[end]
+    const char* source;
+    std::size_t next, end;
 
     void reset() {
-        current_bit = 0;
-        buffer = 0;
+        window = 0;
+        count = 0;
+        consumed = 0;
+        next = end = 0;
+    }
+
+    //top up the window with whole bytes, reading more of the input stream when the byte buffer runs out
+    void refill() {
+        while (count <= 64 - CHAR_BIT) {
+            if (next == end) {
+                if (input == nullptr)
+                    return;
+                input->read(bytes.data(), bytes.size());
+                next = 0;
+                end = static_cast<std::size_t>(input->gcount());
+                if (end == 0)
+                    return;
+            }
+            window |= std::uint64_t(static_cast<unsigned char>(source[next++])) << (64 - CHAR_BIT - count);
+            count += CHAR_BIT;
+        }
     }
 };
 
+template<typename T_BUFFER> const unsigned BitReader<T_BUFFER>::MAX_PEEK;
+template<typename T_BUFFER> const std::size_t BitReader<T_BUFFER>::BUFFER_SIZE;
+
 #endif //DATA_ENCODING_P01_BITREADER_HPP
@@ -1,6 +1,9 @@
 #ifndef DATA_ENCODING_P01_BITBUFFER_HPP
 #define DATA_ENCODING_P01_BITBUFFER_HPP
 
+#include <ostream>
+#include <vector>
+#include <cstdint>
 #include <climits>
 
 /*
@@ -8,63 +11,116 @@
  * Adapted (to use generic ostreams instead of FILE*, and to write MSB-first) from answer by 'Nils Pipenbrinck' on Stack Overflow:
  * (1/10/2016): http://stackoverflow.com/questions/1856514/writing-files-in-bit-form-to-a-file-in-c?noredirect=1&lq=1
  *
- * T_BUFFER is the buffer type used - should be any integral type up to and including long; other types may produce undefined/unexpected behaviour.
+ * Bits are gathered in a 64-bit accumulator and moved out a whole byte at a time into a large byte buffer, which is only
+ * handed to the output stream once it fills up (or on flush). A codeword of up to 64 bits is written with a single call
+ * to writeBits. The bytes may instead be appended to a vector in memory, in which case they go straight into the vector
+ * and there is no byte buffer, so a writer made for each small block of code allocates nothing of its own.
+ *
+ * T_BUFFER is the unit that flush pads the output to - should be any integral type up to and including long; other types may produce undefined/unexpected behaviour.
  */
 template<typename T_BUFFER> class BitWriter {
 public:
     static const int BITS = sizeof(T_BUFFER) * CHAR_BIT;
+    //the number of bytes held back before they are written to the output stream
+    static const std::size_t BUFFER_SIZE = 1 << 16;
+
+    BitWriter(std::ostream& output) : output(&output), sink(nullptr), bytes(BUFFER_SIZE) {
+        reset();
+    }
 
-    BitWriter(std::ostream& output) : output(output) {
+    //write to the end of a vector rather than to a stream
+    BitWriter(std::vector<char>& sink) : output(nullptr), sink(&sink) {
         reset();
     }
 
-    ~BitWriter() = default;
+    //whole bytes still held in the buffer are written, but a partly written byte is only written by flush
+    ~BitWriter() {
+        drain();
+    }
 
     //write an individual bit to the bit buffer. The contents of the buffer will be sent to the output stream if the buffer size is reached.
     //bits are written to the buffer msb-first, left to right.
     void writeBit(int bit) {
-        if (bit)
-            buffer |= (1 << BITS - current_bit - 1);
-        if (++current_bit == BITS) {
-            //write output once a full buffer-size's worth of information is ready
-            output.write(reinterpret_cast<char*>(&buffer),sizeof(T_BUFFER));
-            reset();
+        writeBits(bit ? 1 : 0, 1);
+    }
+
+    //write the low len bits of code, msb-first, len may be anything up to 64
+    void writeBits(std::uint64_t code, unsigned len) {
+        //the accumulator never holds more than 7 bits between calls, so at most 56 more bits can be shifted in at once
+        if (len > 56) {
+            writeBits(code >> 32, len - 32);
+            len = 32;
+        }
+        if (len == 0)
+            return;
+        accumulator = (accumulator << len) | (code & ((std::uint64_t(1) << len) - 1));
+        pending += len;
+        written += len;
+        while (pending >= CHAR_BIT) {
+            pending -= CHAR_BIT;
+            char byte = static_cast<char>(accumulator >> pending);
+            if (sink != nullptr)
+                sink->push_back(byte);
+            else {
+                bytes[used++] = byte;
+                if (used == bytes.size())
+                    drain();
+            }
         }
     }
 
     //write all bits in the value to the buffer
     template<typename T>
     void write(T value) {
-        int t_bits = sizeof(T) * CHAR_BIT;
-        for (int i = 0; i < t_bits; i++)
-            writeBit((1 << CHAR_BIT - i - 1) & value);
+        writeBits(static_cast<std::uint64_t>(value), sizeof(T) * CHAR_BIT);
     }
 
     //flush all current buffered information (if any) to the output stream with trailing zeroes
     void flush() {
-        while (current_bit)
-            writeBit(0);
+        if (getCurrentBit())
+            writeBits(0, BITS - getCurrentBit());
+        drain();
     }
 
     //return true if the output stream says so
     bool good() {
-        return output.good();
+        return output == nullptr || output->good();
     }
 
     //return the current bit (zero based) in the buffer
     int getCurrentBit() {
-        return current_bit;
+        return static_cast<int>(written % BITS);
     }
 
 private:
-    std::ostream& output;
-    int current_bit;
-    T_BUFFER buffer;
+    //exactly one of the output stream and the sink is used
+    std::ostream* output;
+    std::vector<char>* sink;
+    //bits not yet moved into the byte buffer are kept in the low end of the accumulator
+    std::uint64_t accumulator;
+    unsigned pending;
+    //the total number of bits written, for finding the position within a T_BUFFER
+    std::uint64_t written;
+    //the byte buffer, only used with an output stream
+    std::vector<char> bytes;
+    std::size_t used;
 
     void reset() {
-        current_bit = 0;
-        buffer = 0;
+        accumulator = 0;
+        pending = 0;
+        written = 0;
+        used = 0;
+    }
+
+    //send the whole bytes in the byte buffer to the output stream. with a sink the buffer is always empty
+    void drain() {
+        if (used == 0)
+            return;
+        output->write(bytes.data(), used);
+        used = 0;
     }
 };
 
+template<typename T_BUFFER> const std::size_t BitWriter<T_BUFFER>::BUFFER_SIZE;
+
 #endif //DATA_ENCODING_P01_BITBUFFER_HPP
@@ -0,0 +1,25 @@
+#ifndef DATA_ENCODING_P01_BLOCK_HPP
+#define DATA_ENCODING_P01_BLOCK_HPP
+
+/*
+ * A block is a run of consecutively numbered nodes in a code tree that all share the same key. The key is the weight for
+ * FGK trees, where the sibling property guarantees that nodes of equal weight are numbered consecutively; Vitter's
+ * algorithm also keeps leaves and internal nodes of equal weight apart, so its key combines the two.
+ *
+ * A block only needs to know its key and its leader (the highest numbered node in the run); the rest of the block is
+ * found by stepping down through the numbers.
+ */
+struct Block {
+public:
+    long key;
+    unsigned long leader;
+
+    Block(long key, unsigned long leader) {
+        this->key = key;
+        this->leader = leader;
+    }
+
+    Block() : Block(0, 0) {}
+};
+
+#endif //DATA_ENCODING_P01_BLOCK_HPP
@@ -0,0 +1,379 @@
+#ifndef DATA_ENCODING_P01_CONTAINER_HPP
+#define DATA_ENCODING_P01_CONTAINER_HPP
+
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <vector>
+#include "Crc32.hpp"
+
+/*
+ * The layout of a .hff file. Every number is stored little-endian.
+ *
+ * ContainerHeader   "HUFF", version, algorithm, flags, symbol size in bits, block size (symbols), then the rescale
+ *                   threshold with the RESCALE flag and the dictionary id with the DICTIONARY flag, then the CRC-32 of
+ *                   all of the header before it
+ * BlockHeader       bytes of input in the block, bytes of code, CRC-32 of the block's input, CRC-32 of the header's
+ *                   other fields and the code
+ * <code>            the block's symbols, padded with zeroes to a whole byte
+ * ...               one BlockHeader and code per block, every block but the last holding exactly block size symbols
+ * BlockHeader       both lengths zero, marking the end of the blocks
+ * BlockIndexEntry   file offset of the block's header, bytes of input in the block
+ * ...               one per block, none with the UNINDEXED flag
+ * ContainerFooter   total bytes of input, number of blocks, CRC-32 of the index, "FFUH"
+ *
+ * Lengths are counted in bytes of input rather than symbols, so that symbols wider than a byte can code an input which
+ * is not a whole number of them: the last symbol is padded with zero bytes, and the padding is dropped when decoding.
+ *
+ * Normally the code tree carries on from one block to the next, so the blocks must be decoded in order. With the
+ * INDEPENDENT flag every block starts from a new tree instead, so the blocks can be coded in any order, or all at once.
+ * The STATIC algorithm has no tree to carry on: each block's code starts with the code lengths of a static code built
+ * for that block (see StaticCode.hpp), so its blocks are always independent.
+ *
+ * With the RESCALE flag the adaptive trees halve their weights whenever the root's weight passes the rescale threshold
+ * (see HuffmanTree.hpp), which the decoder must know to follow the encoder's tree. With the DICTIONARY flag the trees
+ * start from a preset trained on sample data (see Dictionary.hpp) rather than from nothing, every time they are reset.
+ * The dictionary is not stored in the container, only its id, so the decoder must be given the same dictionary.
+ *
+ * The checksum of the code finds a block which has been corrupted before it is decoded. The checksum of the input is
+ * checked once it has been decoded, so that a block decoded differently from how it was coded, such as with a tree
+ * that does not match the encoder's, is reported rather than written out.
+ *
+ * The footer is a fixed size, so with a seekable input it can be read first to check the file is whole and to find the
+ * index. Without one, the blocks can be decoded in order and the index and footer checked at the end.
+ *
+ * With the UNINDEXED flag there is no index, and the footer's index checksum is zero (the checksum of nothing). This is
+ * for streams which may never end, such as a connection flushed after each message, whose writer would otherwise have
+ * to keep an entry for every block until the end. The blocks of such a container can only be decoded in order.
+ */
+
+//little-endian packing of numbers into bytes
+class LittleEndian {
+public:
+    static void put(char* p, std::uint64_t value, int bytes) {
+        for (int i = 0; i < bytes; i++)
+            p[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+    }
+
+    static std::uint64_t get(const char* p, int bytes) {
+        std::uint64_t value = 0;
+        for (int i = 0; i < bytes; i++)
+            value |= std::uint64_t(static_cast<unsigned char>(p[i])) << (8 * i);
+        return value;
+    }
+};
+
+struct ContainerHeader {
+    //the size of a header with no flags
+    static const std::size_t SIZE = 16;
+    static const unsigned char VERSION = 2;
+    //algorithm ids
+    static const unsigned char FGK = 0;
+    static const unsigned char VITTER = 1;
+    static const unsigned char STATIC = 2;
+    //flags
+    static const unsigned char INDEPENDENT = 1;
+    static const unsigned char RESCALE = 2;
+    static const unsigned char DICTIONARY = 4;
+    static const unsigned char UNINDEXED = 8;
+    //the number of symbols in each block unless told otherwise
+    static const std::uint32_t DEFAULT_BLOCK_SIZE = 1 << 20;
+
+    unsigned char version;
+    unsigned char algorithm;
+    unsigned char flags;
+    unsigned char symbolBits;
+    std::uint32_t blockSize;
+    //only stored with the RESCALE and DICTIONARY flags respectively
+    std::uint32_t rescaleThreshold;
+    std::uint32_t dictionaryId;
+    //the checksum read with the header, which is worked out afresh when it is written
+    std::uint32_t crc;
+
+    ContainerHeader(unsigned char algorithm, unsigned char symbolBits, std::uint32_t blockSize = DEFAULT_BLOCK_SIZE)
+            : version(VERSION), algorithm(algorithm), flags(0), symbolBits(symbolBits), blockSize(blockSize),
+              rescaleThreshold(0), dictionaryId(0), crc(0) {}
+
+    ContainerHeader() : ContainerHeader(FGK, 8) {}
+
+    //return true if each block is coded with a new tree
+    bool isIndependent() const {
+        return (flags & INDEPENDENT) != 0;
+    }
+
+    //return true if the blocks are listed in an index after them
+    bool isIndexed() const {
+        return (flags & UNINDEXED) == 0;
+    }
+
+    //return the threshold at which the trees are rescaled, or 0 if they never are
+    std::uint32_t getRescaleThreshold() const {
+        return (flags & RESCALE) != 0 ? rescaleThreshold : 0;
+    }
+
+    //return the id of the dictionary that the trees start from, or 0 if there is none
+    std::uint32_t getDictionaryId() const {
+        return (flags & DICTIONARY) != 0 ? dictionaryId : 0;
+    }
+
+    //return the lowest rescale threshold for symbols of the size, twice the size of the alphabet. halving rounds up, so
+    //the weights only add up to at most half the threshold plus the number of symbols seen after a rescale, and with the
+    //threshold this high that leaves a quarter of it to count before the next one. any lower, and once enough symbols
+    //have been seen the trees would be rebuilt on every update
+    static std::uint32_t minRescaleThreshold(unsigned symbolBits) {
+        return symbolBits < 30 ? std::uint32_t(2) << symbolBits : INT_MAX;
+    }
+
+    //return false if the header has a rescale threshold which the trees cannot use, as their weights are ints, or which
+    //is below the lowest for its symbol size
+    bool checkRescaleThreshold() const {
+        return (flags & RESCALE) == 0 ||
+               (rescaleThreshold >= minRescaleThreshold(symbolBits) && rescaleThreshold <= INT_MAX);
+    }
+
+    //return the size of a header with the flags in bytes, the rescale threshold and dictionary id taking four more each
+    static std::size_t sizeFor(unsigned char flags) {
+        return SIZE + ((flags & RESCALE) != 0 ? 4 : 0) + ((flags & DICTIONARY) != 0 ? 4 : 0);
+    }
+
+    std::size_t size() const {
+        return sizeFor(flags);
+    }
+
+    //return true if the header read matches its checksum
+    bool check() const {
+        char bytes[SIZE + 8];
+        return Crc32::compute(bytes, pack(bytes)) == crc;
+    }
+
+    void write(std::ostream& output) const {
+        char bytes[SIZE + 8];
+        std::size_t packed = pack(bytes);
+        LittleEndian::put(bytes + packed, Crc32::compute(bytes, packed), 4);
+        output.write(bytes, size());
+    }
+
+    //read a header, returns false if the input does not start with one. whether it is intact is left to check
+    bool read(std::istream& input) {
+        char bytes[FIXED_SIZE];
+        if (!input.read(bytes, FIXED_SIZE) || std::memcmp(bytes, "HUFF", 4) != 0)
+            return false;
+        version = static_cast<unsigned char>(bytes[4]);
+        algorithm = static_cast<unsigned char>(bytes[5]);
+        flags = static_cast<unsigned char>(bytes[6]);
+        symbolBits = static_cast<unsigned char>(bytes[7]);
+        blockSize = static_cast<std::uint32_t>(LittleEndian::get(bytes + 8, 4));
+        rescaleThreshold = 0;
+        dictionaryId = 0;
+        if ((flags & RESCALE) != 0) {
+            if (!input.read(bytes, 4))
+                return false;
+            rescaleThreshold = static_cast<std::uint32_t>(LittleEndian::get(bytes, 4));
+        }
+        if ((flags & DICTIONARY) != 0) {
+            if (!input.read(bytes, 4))
+                return false;
+            dictionaryId = static_cast<std::uint32_t>(LittleEndian::get(bytes, 4));
+        }
+        if (!input.read(bytes, 4))
+            return false;
+        crc = static_cast<std::uint32_t>(LittleEndian::get(bytes, 4));
+        return true;
+    }
+
+private:
+    //the size of the fields every header has, before the optional ones
+    static const std::size_t FIXED_SIZE = 12;
+
+    //pack every field but the checksum into bytes, returns the number of bytes used
+    std::size_t pack(char* bytes) const {
+        std::memcpy(bytes, "HUFF", 4);
+        bytes[4] = static_cast<char>(version);
+        bytes[5] = static_cast<char>(algorithm);
+        bytes[6] = static_cast<char>(flags);
+        bytes[7] = static_cast<char>(symbolBits);
+        LittleEndian::put(bytes + 8, blockSize, 4);
+        char* end = bytes + FIXED_SIZE;
+        if ((flags & RESCALE) != 0) {
+            LittleEndian::put(end, rescaleThreshold, 4);
+            end += 4;
+        }
+        if ((flags & DICTIONARY) != 0) {
+            LittleEndian::put(end, dictionaryId, 4);
+            end += 4;
+        }
+        return end - bytes;
+    }
+};
+
+struct BlockHeader {
+    static const std::size_t SIZE = 16;
+
+    std::uint32_t rawLength;
+    std::uint32_t codedLength;
+    std::uint32_t dataCrc;
+    std::uint32_t crc;
+
+    BlockHeader(std::uint32_t rawLength, std::uint32_t codedLength, std::uint32_t dataCrc, std::uint32_t crc)
+            : rawLength(rawLength), codedLength(codedLength), dataCrc(dataCrc), crc(crc) {}
+
+    BlockHeader() : BlockHeader(0, 0, 0, 0) {}
+
+    //make the header for a block of code, given the checksum of the block's input (see Crc32). the header's own
+    //checksum covers both lengths, the checksum of the input and the code
+    static BlockHeader make(std::uint32_t rawLength, std::uint32_t dataCrc, const char* code, std::uint32_t codedLength) {
+        BlockHeader header(rawLength, codedLength, dataCrc, 0);
+        header.crc = header.checksum(code);
+        return header;
+    }
+
+    //return true if the block's code (of codedLength bytes) matches the checksum
+    bool check(const char* code) const {
+        return checksum(code) == crc;
+    }
+
+    //return true if the block's decoded input (of rawLength bytes) matches the checksum of the input that was coded
+    bool checkData(const void* data) const {
+        return Crc32::compute(static_cast<const char*>(data), rawLength) == dataCrc;
+    }
+
+    //return the number of symbols of symbolSize bytes in the block, counting a last symbol which is cut short
+    std::uint32_t getSymbols(std::size_t symbolSize) const {
+        return static_cast<std::uint32_t>((std::uint64_t(rawLength) + symbolSize - 1) / symbolSize);
+    }
+
+    //return true if this header marks the end of the blocks
+    bool isEnd() const {
+        return rawLength == 0 && codedLength == 0;
+    }
+
+    void write(std::ostream& output) const {
+        char bytes[SIZE];
+        LittleEndian::put(bytes, rawLength, 4);
+        LittleEndian::put(bytes + 4, codedLength, 4);
+        LittleEndian::put(bytes + 8, dataCrc, 4);
+        LittleEndian::put(bytes + 12, crc, 4);
+        output.write(bytes, SIZE);
+    }
+
+    bool read(std::istream& input) {
+        char bytes[SIZE];
+        if (!input.read(bytes, SIZE))
+            return false;
+        rawLength = static_cast<std::uint32_t>(LittleEndian::get(bytes, 4));
+        codedLength = static_cast<std::uint32_t>(LittleEndian::get(bytes + 4, 4));
+        dataCrc = static_cast<std::uint32_t>(LittleEndian::get(bytes + 8, 4));
+        crc = static_cast<std::uint32_t>(LittleEndian::get(bytes + 12, 4));
+        return true;
+    }
+
+private:
+    std::uint32_t checksum(const char* code) const {
+        char fields[12];
+        LittleEndian::put(fields, rawLength, 4);
+        LittleEndian::put(fields + 4, codedLength, 4);
+        LittleEndian::put(fields + 8, dataCrc, 4);
+        return Crc32::update(Crc32::compute(fields, 12), code, codedLength);
+    }
+};
+
+struct BlockIndexEntry {
+    static const std::size_t SIZE = 12;
+
+    std::uint64_t offset;
+    std::uint32_t rawLength;
+
+    BlockIndexEntry(std::uint64_t offset, std::uint32_t rawLength) : offset(offset), rawLength(rawLength) {}
+
+    BlockIndexEntry() : BlockIndexEntry(0, 0) {}
+
+    //return the checksum of an index ending with this entry, crc being the checksum of the entries before it. this lets
+    //the checksum of an index be worked out without keeping the index
+    std::uint32_t addTo(std::uint32_t crc) const {
+        char bytes[SIZE];
+        pack(bytes);
+        return Crc32::update(crc, bytes, SIZE);
+    }
+
+    //write the whole index an entry at a time, returns its checksum
+    static std::uint32_t writeIndex(std::ostream& output, const std::vector<BlockIndexEntry>& index) {
+        std::uint32_t crc = 0;
+        for (const BlockIndexEntry& entry : index) {
+            char bytes[SIZE];
+            entry.pack(bytes);
+            output.write(bytes, SIZE);
+            crc = Crc32::update(crc, bytes, SIZE);
+        }
+        return crc;
+    }
+
+    //read an index of count entries an entry at a time, into the index's existing room where there is enough. returns
+    //false if it could not be read or does not match the checksum
+    static bool readIndex(std::istream& input, std::uint32_t count, std::uint32_t crc, std::vector<BlockIndexEntry>& index) {
+        index.clear();
+        std::uint32_t read = 0;
+        for (std::uint32_t i = 0; i < count; i++) {
+            char bytes[SIZE];
+            if (!input.read(bytes, SIZE))
+                return false;
+            read = Crc32::update(read, bytes, SIZE);
+            index.push_back(BlockIndexEntry(LittleEndian::get(bytes, 8),
+                                            static_cast<std::uint32_t>(LittleEndian::get(bytes + 8, 4))));
+        }
+        return read == crc;
+    }
+
+    //unpack the entries of an index, returns false if the bytes do not match the checksum
+    static bool parseIndex(const std::vector<char>& bytes, std::uint32_t crc, std::vector<BlockIndexEntry>& index) {
+        if (Crc32::compute(bytes.data(), bytes.size()) != crc)
+            return false;
+        index.resize(bytes.size() / SIZE);
+        for (std::size_t i = 0; i < index.size(); i++)
+            index[i] = BlockIndexEntry(LittleEndian::get(&bytes[i * SIZE], 8),
+                                       static_cast<std::uint32_t>(LittleEndian::get(&bytes[i * SIZE + 8], 4)));
+        return true;
+    }
+
+private:
+    void pack(char* bytes) const {
+        LittleEndian::put(bytes, offset, 8);
+        LittleEndian::put(bytes + 8, rawLength, 4);
+    }
+};
+
+struct ContainerFooter {
+    static const std::size_t SIZE = 20;
+
+    std::uint64_t originalLength;
+    std::uint32_t blockCount;
+    std::uint32_t indexCrc;
+
+    ContainerFooter(std::uint64_t originalLength, std::uint32_t blockCount, std::uint32_t indexCrc)
+            : originalLength(originalLength), blockCount(blockCount), indexCrc(indexCrc) {}
+
+    ContainerFooter() : ContainerFooter(0, 0, 0) {}
+
+    void write(std::ostream& output) const {
+        char bytes[SIZE];
+        LittleEndian::put(bytes, originalLength, 8);
+        LittleEndian::put(bytes + 8, blockCount, 4);
+        LittleEndian::put(bytes + 12, indexCrc, 4);
+        std::memcpy(bytes + 16, "FFUH", 4);
+        output.write(bytes, SIZE);
+    }
+
+    //read a footer, returns false if there is not one
+    bool read(std::istream& input) {
+        char bytes[SIZE];
+        if (!input.read(bytes, SIZE) || std::memcmp(bytes + 16, "FFUH", 4) != 0)
+            return false;
+        originalLength = LittleEndian::get(bytes, 8);
+        blockCount = static_cast<std::uint32_t>(LittleEndian::get(bytes + 8, 4));
+        indexCrc = static_cast<std::uint32_t>(LittleEndian::get(bytes + 12, 4));
+        return true;
+    }
+};
+
+#endif //DATA_ENCODING_P01_CONTAINER_HPP
@@ -0,0 +1,58 @@
+#ifndef DATA_ENCODING_P01_CRC32_HPP
+#define DATA_ENCODING_P01_CRC32_HPP
+
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * The CRC-32 used by zip and gzip (reflected, polynomial 0xEDB88320), computed eight bytes at a time from eight lookup
+ * tables (slicing-by-8), the bytes left over being done one at a time from the first.
+ */
+class Crc32 {
+public:
+    //return the checksum of the data
+    static std::uint32_t compute(const char* data, std::size_t size) {
+        return update(0, data, size);
+    }
+
+    //return the checksum of everything passed to the previous call followed by the data, crc being that call's result
+    static std::uint32_t update(std::uint32_t crc, const char* data, std::size_t size) {
+        const std::uint32_t (*table)[256] = getTables();
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+        crc = ~crc;
+        for (; size >= 8; size -= 8, p += 8) {
+            std::uint32_t low = crc ^ (std::uint32_t(p[0]) | std::uint32_t(p[1]) << 8 | std::uint32_t(p[2]) << 16 |
+                                       std::uint32_t(p[3]) << 24);
+            crc = table[7][low & 0xFF] ^ table[6][(low >> 8) & 0xFF] ^ table[5][(low >> 16) & 0xFF] ^
+                  table[4][low >> 24] ^ table[3][p[4]] ^ table[2][p[5]] ^ table[1][p[6]] ^ table[0][p[7]];
+        }
+        for (; size > 0; size--, p++)
+            crc = table[0][(crc ^ *p) & 0xFF] ^ (crc >> 8);
+        return ~crc;
+    }
+
+private:
+    //the first table is the checksum of each byte, and each one after it that of the byte followed by a zero byte more
+    static const std::uint32_t (*getTables())[256] {
+        struct Tables {
+            std::uint32_t entries[8][256];
+
+            Tables() {
+                for (std::uint32_t i = 0; i < 256; i++) {
+                    std::uint32_t c = i;
+                    for (int k = 0; k < 8; k++)
+                        c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+                    entries[0][i] = c;
+                }
+                for (std::uint32_t i = 0; i < 256; i++) {
+                    for (int t = 1; t < 8; t++)
+                        entries[t][i] = entries[0][entries[t - 1][i] & 0xFF] ^ (entries[t - 1][i] >> 8);
+                }
+            }
+        };
+        static const Tables tables;
+        return tables.entries;
+    }
+};
+
+#endif //DATA_ENCODING_P01_CRC32_HPP
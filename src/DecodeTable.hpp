@@ -0,0 +1,95 @@
+#ifndef DATA_ENCODING_P01_DECODETABLE_HPP
+#define DATA_ENCODING_P01_DECODETABLE_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "HuffmanTree.hpp"
+
+/*
+ * Lookup table for decoding up to BITS bits of a codeword at once. The table is indexed by the next BITS bits of input,
+ * and each entry holds the node reached by walking down from the root with those bits, stopping early at a leaf, along
+ * with the number of bits the walk used. If the node is internal the codeword is longer than BITS bits, and decoding
+ * carries on from that node one bit at a time.
+ *
+ * The tree changes after every symbol, so the table follows the nodes which the tree reports as changed. An entry only
+ * goes stale when a node on its walk (other than the last) has its children changed, and all of the entries which walk
+ * through a node at depth d share the node's code as a prefix, so the 2^(BITS-d) entries below each changed node which
+ * is shallower than BITS are marked as stale. A stale entry is only worked out again when it is next looked up, as
+ * while the tree is young most of the table goes stale after every symbol.
+ */
+template<typename T> class DecodeTable {
+public:
+    //the number of bits resolved by one probe of the table
+    static const unsigned BITS = 10;
+
+    struct Entry {
+        std::uint32_t node;
+        std::uint32_t length;
+    };
+
+    DecodeTable(HuffmanTree<T>& tree) : tree(tree), entries(1UL << BITS), stale(1UL << BITS, 1) {
+        tree.trackChanges(true);
+    }
+
+    ~DecodeTable() {
+        tree.trackChanges(false);
+    }
+
+    //mark the entries affected by the changes made to the tree since the last call as stale
+    void update() {
+        const std::vector<unsigned long>& changed = tree.getChanged();
+        for (unsigned long node : changed)
+            invalidate(node);
+        tree.clearChanged();
+    }
+
+    //return the entry for the next BITS bits of input, the first of which is the most significant
+    const Entry& lookup(unsigned long bits) {
+        if (stale[bits]) {
+            entries[bits] = walk(bits);
+            stale[bits] = 0;
+        }
+        return entries[bits];
+    }
+
+private:
+    HuffmanTree<T>& tree;
+    std::vector<Entry> entries;
+    //entries which need working out again before they are used
+    std::vector<unsigned char> stale;
+
+    //mark the entries which walk through the numbered node as stale, if it is shallow enough to be in the table at all
+    void invalidate(unsigned long node) {
+        //numbers below the NYT node are not in the tree (any more)
+        if (node < tree.getNYTIndex())
+            return;
+        unsigned long code = 0;
+        unsigned depth = 0;
+        while (node != tree.getRootIndex()) {
+            if (++depth >= BITS)
+                return;
+            unsigned long parent = tree.getParent(node);
+            if (tree.getChild(parent, 1) == node)
+                code |= 1UL << (depth - 1);
+            node = parent;
+        }
+        std::fill(stale.begin() + (code << (BITS - depth)), stale.begin() + ((code + 1) << (BITS - depth)), 1);
+    }
+
+    //walk down from the root with the bits, stopping early at a leaf
+    Entry walk(unsigned long bits) {
+        unsigned long node = tree.getRootIndex();
+        std::uint32_t depth = 0;
+        while (depth < BITS && !tree.isLeaf(node)) {
+            node = tree.getChild(node, (bits >> (BITS - 1 - depth)) & 1);
+            depth++;
+        }
+        Entry entry = { static_cast<std::uint32_t>(node), depth };
+        return entry;
+    }
+};
+
+template<typename T> const unsigned DecodeTable<T>::BITS;
+
+#endif //DATA_ENCODING_P01_DECODETABLE_HPP
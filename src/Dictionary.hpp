@@ -0,0 +1,148 @@
+#ifndef DATA_ENCODING_P01_DICTIONARY_HPP
+#define DATA_ENCODING_P01_DICTIONARY_HPP
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <vector>
+#include "Container.hpp"
+#include "Crc32.hpp"
+
+/*
+ * A preset for the code trees, trained on sample data: how often each symbol appeared in the samples. A tree given the
+ * dictionary's weights (see HuffmanTree::setPreset) starts out as though it had already coded the samples, so the
+ * symbols they hold are coded without the NYT escape and its literal from the first symbol on. This matters most for
+ * short inputs, such as small messages, where escaping every new symbol costs most of what coding saves.
+ *
+ * The counts are scaled down so that they add up to about TOTAL_WEIGHT, which is few enough that the tree still follows
+ * the input being coded once it differs from the samples. Every symbol which appeared keeps a weight of at least one.
+ *
+ * The file layout, every number being little-endian:
+ *
+ * "HUFD", version, symbol size in bits, two zero bytes, number of entries
+ * symbol, weight   one entry per symbol with a nonzero weight, in symbol order. the symbol takes as many bytes as T
+ * CRC-32           of everything before it, which is also the dictionary's id, recorded in the containers using it
+ */
+template<typename T> class Dictionary {
+public:
+    static const unsigned char VERSION = 1;
+    static const unsigned long ALPHABET_SIZE = 1UL << (sizeof(T) * CHAR_BIT);
+    static const std::uint64_t TOTAL_WEIGHT = 1 << 8;
+
+    Dictionary() : counts(ALPHABET_SIZE, 0), scaled(false) {}
+
+    //count the symbols of a sample, which adds to those of any samples already counted
+    void train(const T* symbols, std::size_t n) {
+        scaled = false;
+        for (std::size_t i = 0; i < n; i++)
+            counts[symbols[i]]++;
+    }
+
+    //return true if no symbols have been counted
+    bool empty() const {
+        for (std::uint64_t count : counts) {
+            if (count != 0)
+                return false;
+        }
+        return true;
+    }
+
+    //return the weight of each symbol, indexed by symbol, for HuffmanTree::setPreset
+    std::vector<int> getWeights() const {
+        std::uint64_t total = 0;
+        for (std::uint64_t count : counts)
+            total += count;
+        std::vector<int> weights(ALPHABET_SIZE, 0);
+        for (unsigned long s = 0; s < ALPHABET_SIZE; s++) {
+            if (counts[s] != 0 && (scaled || total <= TOTAL_WEIGHT))
+                weights[s] = static_cast<int>(counts[s]);
+            else if (counts[s] != 0)
+                weights[s] = static_cast<int>(std::max<std::uint64_t>(1, counts[s] * TOTAL_WEIGHT / total));
+        }
+        return weights;
+    }
+
+    //return the id of the dictionary, the checksum of its file
+    std::uint32_t getId() const {
+        std::vector<char> bytes = serialise();
+        return static_cast<std::uint32_t>(LittleEndian::get(bytes.data() + bytes.size() - 4, 4));
+    }
+
+    void write(std::ostream& output) const {
+        std::vector<char> bytes = serialise();
+        output.write(bytes.data(), bytes.size());
+    }
+
+    //read a dictionary of symbols of type T, replacing any counts. returns false if the input is not such a dictionary
+    //or is corrupt, leaving the dictionary empty
+    bool read(std::istream& input) {
+        std::fill(counts.begin(), counts.end(), 0);
+        scaled = true;
+        char header[HEADER_SIZE];
+        if (!input.read(header, HEADER_SIZE) || std::memcmp(header, "HUFD", 4) != 0 || header[4] != VERSION ||
+            static_cast<unsigned char>(header[5]) != sizeof(T) * CHAR_BIT)
+            return false;
+        std::uint64_t entries = LittleEndian::get(header + 8, 4);
+        if (entries > ALPHABET_SIZE)
+            return false;
+        std::vector<char> bytes(static_cast<std::size_t>(entries) * ENTRY_SIZE + 4);
+        if (!input.read(bytes.data(), bytes.size()))
+            return false;
+        std::uint32_t crc = Crc32::update(Crc32::compute(header, HEADER_SIZE), bytes.data(), bytes.size() - 4);
+        if (crc != LittleEndian::get(bytes.data() + bytes.size() - 4, 4))
+            return false;
+        for (std::size_t i = 0; i < entries; i++) {
+            const char* entry = bytes.data() + i * ENTRY_SIZE;
+            std::uint64_t weight = LittleEndian::get(entry + sizeof(T), 4);
+            if (weight == 0 || weight > TOTAL_WEIGHT) {
+                std::fill(counts.begin(), counts.end(), 0);
+                return false;
+            }
+            counts[static_cast<T>(LittleEndian::get(entry, sizeof(T)))] = weight;
+        }
+        return true;
+    }
+
+private:
+    static const std::size_t HEADER_SIZE = 12;
+    static const std::size_t ENTRY_SIZE = sizeof(T) + 4;
+
+    //the number of times each symbol appeared in the samples, or its weight if read from a file (which is already scaled)
+    std::vector<std::uint64_t> counts;
+    bool scaled;
+
+    //return the bytes of the dictionary's file
+    std::vector<char> serialise() const {
+        std::vector<int> weights = getWeights();
+        std::vector<char> bytes(HEADER_SIZE, 0);
+        std::memcpy(bytes.data(), "HUFD", 4);
+        bytes[4] = static_cast<char>(VERSION);
+        bytes[5] = static_cast<char>(sizeof(T) * CHAR_BIT);
+        std::uint32_t entries = 0;
+        for (unsigned long s = 0; s < ALPHABET_SIZE; s++) {
+            if (weights[s] == 0)
+                continue;
+            char entry[ENTRY_SIZE];
+            LittleEndian::put(entry, s, sizeof(T));
+            LittleEndian::put(entry + sizeof(T), static_cast<std::uint64_t>(weights[s]), 4);
+            bytes.insert(bytes.end(), entry, entry + ENTRY_SIZE);
+            entries++;
+        }
+        LittleEndian::put(bytes.data() + 8, entries, 4);
+        char crc[4];
+        LittleEndian::put(crc, Crc32::compute(bytes.data(), bytes.size()), 4);
+        bytes.insert(bytes.end(), crc, crc + 4);
+        return bytes;
+    }
+};
+
+template<typename T> const unsigned char Dictionary<T>::VERSION;
+template<typename T> const unsigned long Dictionary<T>::ALPHABET_SIZE;
+template<typename T> const std::uint64_t Dictionary<T>::TOTAL_WEIGHT;
+template<typename T> const std::size_t Dictionary<T>::HEADER_SIZE;
+template<typename T> const std::size_t Dictionary<T>::ENTRY_SIZE;
+
+#endif //DATA_ENCODING_P01_DICTIONARY_HPP
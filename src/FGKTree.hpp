@@ -2,16 +2,37 @@
 #define DATA_ENCODING_P01_FGKTREE_HPP
 
 #include "HuffmanTree.hpp"
-#include "BitReader.hpp"
+#include "NodeData.hpp"
+#include "Node.hpp"
+#include "Stats.hpp"
 
+/*
+ * FGK code tree made of linked Node objects. Each node holds its own number, and the tree keeps the nodes ordered by
+ * number alongside a symbol-indexed table of leaves.
+ *
+ * Apart from the root, the nodes are taken in turn from a pool made up front with room for every node the tree can
+ * hold, so no node is allocated on its own while coding. reset rewinds the pool rather than freeing the nodes, and only
+ * clears as much of the tables as the tree had come to use.
+ *
+ * A copy takes its own pool, in which each node is at the same place as in the original, so the links between the nodes
+ * are copied by pointing them at the same places in the new pool.
+ */
 template<typename T> class FGKTree : public HuffmanTree<T> {
-    using HuffmanTree<T>::root;
-    using HuffmanTree<T>::indices;
-    using HuffmanTree<T>::reassignIndices;
-    using HuffmanTree<T>::getNYTNode;
-    using HuffmanTree<T>::makeNYT;
-    using HuffmanTree<T>::findWeightGroup;
-    using HuffmanTree<T>::findLeaf;
+    using HuffmanTree<T>::ALPHABET_SIZE;
+    using HuffmanTree<T>::getMaxNodes;
+    using HuffmanTree<T>::getRootIndex;
+    using HuffmanTree<T>::resetBlocks;
+    using HuffmanTree<T>::getBlockLeader;
+    using HuffmanTree<T>::joinBlock;
+    using HuffmanTree<T>::leaveBlock;
+    using HuffmanTree<T>::touch;
+    using HuffmanTree<T>::touchAll;
+    using HuffmanTree<T>::invalidateCodes;
+    using HuffmanTree<T>::needsRescale;
+    using HuffmanTree<T>::planRescale;
+    using HuffmanTree<T>::rescaled;
+    using HuffmanTree<T>::preset;
+    using HuffmanTree<T>::presetNYT;
     /*
      * Update procedure derived from figure 3.6,
      * Sayood, K. (2006). Introduction to data compression. Amsterdam: Elsevier, p59
@@ -49,7 +70,40 @@ template<typename T> class FGKTree : public HuffmanTree<T> {
      *
      */
 public:
-    FGKTree() : HuffmanTree<T>() {}
+    FGKTree() : HuffmanTree<T>(), pool(getMaxNodes() - 1), allocated(0) {
+        nodes = std::vector<Node<NodeData<T>, 2>*>(getMaxNodes(), nullptr);
+        leaves = std::vector<Node<NodeData<T>, 2>*>(ALPHABET_SIZE, nullptr);
+        nyt = &root;
+        reset();
+    }
+
+    //the pool owns the nodes, so the links between them are dropped before anything is destructed
+    ~FGKTree() {
+        root.clearChildren();
+        for (std::size_t i = 0; i < allocated; i++)
+            pool[i].clearChildren();
+    }
+
+    FGKTree(const FGKTree& other) : HuffmanTree<T>(other), root(other.root), pool(other.pool),
+                                    allocated(other.allocated), nodes(other.nodes), leaves(other.leaves) {
+        relink(other, &root);
+        for (std::size_t i = 0; i < allocated; i++)
+            relink(other, &pool[i]);
+        for (unsigned long i = getIndex(other.nyt); i <= getRootIndex(); i++)
+            nodes[i] = find(other, nodes[i]);
+        for (std::size_t i = 0; i < allocated; i++) {
+            NodeData<T>& data = pool[i].getElement();
+            if (data.value.exists())
+                leaves[data.value.value()] = &pool[i];
+        }
+        nyt = find(other, other.nyt);
+    }
+
+    FGKTree& operator=(const FGKTree&) = delete;
+
+    virtual HuffmanTree<T>* clone() override {
+        return new FGKTree<T>(*this);
+    }
 
     virtual void update(T c) override {
         Node<NodeData<T>, 2>* leaf = findLeaf(c);
@@ -60,22 +114,216 @@ public:
                 swapTowardsRoot(oldNYT->getParent());
         } else
             swapTowardsRoot(leaf);
-        //reorganise the indices
-        reassignIndices();
+        if (needsRescale())
+            rescale();
+    }
+
+    virtual void rescale() override {
+        planRescale();
+        build(rescaled, getIndex(nyt));
+    }
+
+    virtual void reset() override {
+        clear();
+        if (preset)
+            build(*preset, presetNYT);
+    }
+
+    virtual unsigned long getNYTIndex() override {
+        return getIndex(nyt);
+    }
+
+    virtual bool isLeaf(unsigned long node) override {
+        return nodes[node]->isLeaf();
+    }
+
+    virtual unsigned long getChild(unsigned long node, int bit) override {
+        return getIndex(nodes[node]->child(bit));
+    }
+
+    virtual unsigned long getParent(unsigned long node) override {
+        return getIndex(nodes[node]->getParent());
+    }
+
+    virtual T getSymbol(unsigned long node) override {
+        return nodes[node]->getElement().value.value();
+    }
+
+    virtual int getWeight(unsigned long node) override {
+        return nodes[node]->getElement().weight;
+    }
+
+    virtual bool hasSymbol(T symbol) override {
+        return leaves[symbol] != nullptr;
+    }
+
+    virtual unsigned long getLeafIndex(T symbol) override {
+        return getIndex(leaves[symbol]);
+    }
+
+    //return a reference to the root of the tree
+    Node<NodeData<T>, 2>& getRoot() {
+        return root;
+    }
+
+    //get the NYT node, this is tracked by the tree itself so no search is required
+    Node<NodeData<T>, 2>* getNYTNode() {
+        return nyt;
+    }
+
+    //look up the leaf for a symbol in the leaf table, returns null if the symbol has not appeared yet
+    Node<NodeData<T>, 2>* findLeaf(T symbol) {
+        return leaves[symbol];
+    }
+
+    //return the nodes of the tree ordered by their number, unused numbers (below the NYT node) are null
+    const std::vector<Node<NodeData<T>, 2>*>& getNodes() {
+        return nodes;
+    }
+
+    //return the node's number in the sibling ordering
+    unsigned long getIndex(Node<NodeData<T>, 2>* node) {
+        return node->getElement().index;
+    }
+
+protected:
+    virtual void restore(const typename HuffmanTree<T>::Plan& plan, unsigned long lowest) override {
+        clear();
+        build(plan, lowest);
     }
 
 private:
+    Node<NodeData<T>, 2> root;
+    //every other node, of which the first allocated are in the tree
+    std::vector<Node<NodeData<T>, 2>> pool;
+    std::size_t allocated;
+    //the nodes ordered by number, such that nodes[getIndex(node)] == node
+    std::vector<Node<NodeData<T>, 2>*> nodes;
+    //symbol-indexed table of leaves, null for symbols which have not appeared yet
+    std::vector<Node<NodeData<T>, 2>*> leaves;
+    //the current NYT leaf
+    Node<NodeData<T>, 2>* nyt;
+
+    //make the data of an NYT node, with the weight set to 0 and the optional set to non-existent
+    static NodeData<T> makeNYT() {
+        return NodeData<T> { 0, Optional<T>() };
+    }
+
+    //take the next node from the pool, holding the data and with no children
+    Node<NodeData<T>, 2>* allocate(const NodeData<T>& data) {
+        Node<NodeData<T>, 2>* node = &pool[allocated++];
+        node->setElement(data);
+        node->setParent(nullptr);
+        return node;
+    }
+
+    //give the node a number, nodes keep their number for as long as they are in the tree
+    void assignIndex(Node<NodeData<T>, 2>* node, unsigned long index) {
+        node->getElement().index = index;
+        nodes[index] = node;
+    }
+
+    //record the node in the leaf table (or as the NYT node) if it is a leaf, should be called whenever a node's element changes
+    void trackLeaf(Node<NodeData<T>, 2>* node) {
+        if (!node->isLeaf())
+            return;
+        NodeData<T>& data = node->getElement();
+        if (data.value.exists())
+            leaves[data.value.value()] = node;
+        else
+            nyt = node;
+    }
+
+    //empty the tree back to the lone root node
+    void clear() {
+        //only the numbers from the NYT node up, and the symbols held by the nodes taken from the pool, are in use
+        unsigned long lowest = getIndex(nyt);
+        std::fill(nodes.begin() + lowest, nodes.end(), nullptr);
+        for (std::size_t i = 0; i < allocated; i++) {
+            NodeData<T>& data = pool[i].getElement();
+            if (data.value.exists())
+                leaves[data.value.value()] = nullptr;
+            pool[i].clearChildren();
+        }
+        allocated = 0;
+        root.clearChildren();
+        root.setElement(makeNYT());
+        //the root always holds the highest number
+        assignIndex(&root, getRootIndex());
+        nyt = &root;
+        touchAll();
+        //the root starts alone in its own block
+        resetBlocks(lowest);
+        joinBlock(getRootIndex(), 0);
+    }
+
+    //return the node of this tree at the same place as a node of the other tree
+    Node<NodeData<T>, 2>* find(const FGKTree& other, Node<NodeData<T>, 2>* node) {
+        if (node == nullptr)
+            return nullptr;
+        return node == &other.root ? &root : &pool[node - other.pool.data()];
+    }
+
+    //point the children of a node copied from the other tree at the nodes of this tree, which also points their parent
+    //links back at the node
+    void relink(const FGKTree& other, Node<NodeData<T>, 2>* node) {
+        node->setChildren({{find(other, node->child(0)), find(other, node->child(1))}});
+    }
+
+    //make the tree the planned one (see planTree), the NYT node being numbered lowest. the nodes already in the tree keep
+    //their numbers, each just being given its new weight and contents, and any more that are needed come from the pool
+    void build(const typename HuffmanTree<T>::Plan& plan, unsigned long lowest) {
+        for (unsigned long i = lowest; i < getRootIndex(); i++) {
+            if (nodes[i] == nullptr)
+                assignIndex(allocate(makeNYT()), i);
+        }
+        for (unsigned long i = lowest; i <= getRootIndex(); i++) {
+            const typename HuffmanTree<T>::PlannedNode& planned = plan[i];
+            NodeData<T>& data = nodes[i]->getElement();
+            data.weight = planned.weight;
+            data.value = planned.leaf && i != lowest ? Optional<T>(planned.symbol) : Optional<T>();
+            if (planned.leaf)
+                nodes[i]->clearChildren();
+            else
+                nodes[i]->setChildren({{nodes[planned.child], nodes[planned.child + 1]}});
+            trackLeaf(nodes[i]);
+        }
+        touchAll();
+        //join the blocks from the top down, as each node may join the block above it
+        resetBlocks(lowest);
+        for (unsigned long i = getRootIndex() + 1; i-- > lowest;)
+            joinBlock(i, nodes[i]->getElement().weight);
+    }
+
+    //increment the weight of a node which leads its block, moving it into the block above
+    void incrementWeight(Node<NodeData<T>, 2>* node) {
+        leaveBlock(getIndex(node));
+        node->getElement().increment();
+        joinBlock(getIndex(node), node->getElement().weight);
+    }
+
     //create a new node at the NYT position, the left child being the new NYT node, and the right a new external node with weight 1 and a source alphabet value
     //returns the old NYT node
     Node<NodeData<T>, 2>* newNode(T value) {
         Node<NodeData<T>, 2> *node, *nyt, *newNyt;
         nyt = getNYTNode();
-        node = new Node<NodeData<T>, 2>(NodeData<T> { 0, Optional<T>(value) });
-        newNyt = new Node<NodeData<T>, 2>(makeNYT());
+        leaveBlock(getIndex(nyt));
+        node = allocate(NodeData<T> { 0, Optional<T>(value) });
+        newNyt = allocate(makeNYT());
         nyt->getElement().increment();
         node->getElement().increment();
+        touch(getIndex(nyt));
         nyt->setChild(0, newNyt);
         nyt->setChild(1, node);
+        //the new children take the two lowest numbers, the external node being the higher of the two
+        assignIndex(node, getIndex(nyt) - 1);
+        assignIndex(newNyt, getIndex(nyt) - 2);
+        trackLeaf(newNyt);
+        trackLeaf(node);
+        //join the blocks from the top down, as each node may join the block above it
+        joinBlock(getIndex(nyt), nyt->getElement().weight);
+        joinBlock(getIndex(node), node->getElement().weight);
+        joinBlock(getIndex(newNyt), newNyt->getElement().weight);
         return nyt;
     }
 
@@ -84,39 +332,39 @@ private:
     void swapTowardsRoot(Node<NodeData<T>, 2> *inputNode) {
         Node<NodeData<T>, 2>* node = inputNode;
         while (node != nullptr) {
-            Node<NodeData<T>, 2>* max = getMaxInWeightGroup(node->getElement().weight);
+            Node<NodeData<T>, 2>* max = nodes[getBlockLeader(getIndex(node))];
             //do not swap if the max node is this node's parent [not specified in (Sayood 2006)]
-            if (node == max || max == node->getParent())
-                node->getElement().increment();
-            else {
-                NodeData<T> nodeData = node->getElement();
+            //this only happens when the node's sibling is the NYT node, the parent is incremented first so that the node
+            //then leads the block itself
+            if (max == node->getParent()) {
+                incrementWeight(max);
+                incrementWeight(node);
+                node = max->getParent();
+                continue;
+            }
+            if (node != max) {
+                HUFF_COUNT(SWAPS, 1);
+                Optional<T> nodeValue = node->getElement().value;
                 std::array<Node<NodeData<T>, 2>*, 2> nodeChildren = node->getChildren();
-                NodeData<T> maxData = max->getElement();
-                std::array<Node<NodeData<T>, 2>*, 2> maxChildren = max->getChildren();
-                //swap the nodes' values and list of children
-                node->setElement(maxData);
-                node->setChildren(maxChildren);
-                max->setElement(nodeData);
+                //swap the nodes' values and list of children, the weights are equal and the numbers stay with the positions
+                node->getElement().value = max->getElement().value;
+                node->setChildren(max->getChildren());
+                max->getElement().value = nodeValue;
                 max->setChildren(nodeChildren);
-                //increment the weight of what was the current node (node corresponding to the input value)
-                max->getElement().increment();
+                //any leaf that moved must be found at its new position
+                trackLeaf(node);
+                trackLeaf(max);
+                touch(getIndex(node));
+                touch(getIndex(max));
+                invalidateCodes(getIndex(node));
+                invalidateCodes(getIndex(max));
+                //carry on from the position that the node's contents were moved to
+                node = max;
             }
+            incrementWeight(node);
             node = node->getParent();
         }
     }
-
-    //find the node with weight 'block' with the highest index
-    Node<NodeData<T>, 2>* getMaxInWeightGroup(int block) {
-        Node<NodeData<T>, 2>* max = nullptr;
-        long maxIndex = 0;
-        for (auto node : findWeightGroup(block)) {
-            if (max == nullptr || indices[node] > maxIndex) {
-                max = node;
-                maxIndex = indices[node];
-            }
-        }
-        return max;
-    }
 };
 
 #endif //DATA_ENCODING_P01_FGKTREE_HPP
@@ -0,0 +1,257 @@
+#include "Huff.hpp"
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include "Dictionary.hpp"
+#include "FGKTree.hpp"
+#include "VitterTree.hpp"
+#include "HuffmanEncoder.hpp"
+#include "HuffmanDecoder.hpp"
+#include "MemoryBuffer.hpp"
+#include "StreamCoder.hpp"
+
+namespace huff {
+
+/*
+ * Streams over the caller's buffers, and an encoder and decoder for each algorithm bound to them. The streams are
+ * pointed at new buffers on each call, so everything else is made once.
+ */
+struct Context::State {
+    MemoryBuffer inputBuffer;
+    FixedOutputBuffer outputBuffer;
+    std::istream input;
+    std::ostream output;
+    //the encoder caches codes in its tree and the decoder has its tree track changes, so they each have their own
+    FGKTree<unsigned char> fgkEncodeTree, fgkDecodeTree;
+    VitterTree<unsigned char> vitterEncodeTree, vitterDecodeTree;
+    HuffmanEncoder<unsigned char> fgkEncoder, vitterEncoder;
+    HuffmanDecoder<unsigned char> fgkDecoder, vitterDecoder;
+    //the id of the dictionary the trees start from, or 0 if there is none
+    std::uint32_t dictionaryId;
+    std::string error;
+
+    State() : inputBuffer(nullptr, 0), input(&inputBuffer), output(&outputBuffer),
+              fgkEncoder(input, output, fgkEncodeTree), vitterEncoder(input, output, vitterEncodeTree),
+              fgkDecoder(input, output, fgkDecodeTree), vitterDecoder(input, output, vitterDecodeTree),
+              dictionaryId(0) {}
+
+    //point the streams at the buffers
+    void open(const std::uint8_t* in, std::size_t size, std::uint8_t* out, std::size_t capacity) {
+        inputBuffer.assign(reinterpret_cast<const char*>(in), size);
+        outputBuffer.assign(reinterpret_cast<char*>(out), capacity);
+        input.clear();
+        output.clear();
+        error.clear();
+    }
+
+    std::size_t fail(const std::string& reason) {
+        error = reason;
+        return FAILED;
+    }
+};
+
+//make the header described by the options
+static ContainerHeader makeHeader(const Options& options) {
+    unsigned char algorithm = options.algorithm == VITTER ? ContainerHeader::VITTER :
+                              options.algorithm == STATIC ? ContainerHeader::STATIC : ContainerHeader::FGK;
+    ContainerHeader header(algorithm, CHAR_BIT, options.blockSize);
+    if (options.independent || options.algorithm == STATIC)
+        header.flags |= ContainerHeader::INDEPENDENT;
+    if (options.rescaleThreshold != 0 && options.algorithm != STATIC) {
+        header.flags |= ContainerHeader::RESCALE;
+        header.rescaleThreshold = std::max(ContainerHeader::minRescaleThreshold(CHAR_BIT),
+                                           std::min<std::uint32_t>(options.rescaleThreshold, INT_MAX));
+    }
+    return header;
+}
+
+//make the code tree for the algorithm in the header, or null if it is not known. the STATIC algorithm has no use for
+//a tree, but is given one as the decoder needs one
+static HuffmanTree<unsigned char>* makeTree(const ContainerHeader& header) {
+    if (header.algorithm == ContainerHeader::VITTER)
+        return new VitterTree<unsigned char>();
+    if (header.algorithm == ContainerHeader::FGK || header.algorithm == ContainerHeader::STATIC)
+        return new FGKTree<unsigned char>();
+    return nullptr;
+}
+
+Context::Context() : state(new State()) {}
+
+Context::~Context() {}
+
+std::size_t Context::compress(const std::uint8_t* input, std::size_t size, std::uint8_t* output, std::size_t capacity,
+                              const Options& options) {
+    if (options.blockSize == 0)
+        return state->fail("the block size must be at least 1");
+    state->open(input, size, output, capacity);
+    ContainerHeader header = makeHeader(options);
+    if (state->dictionaryId != 0 && options.algorithm != STATIC) {
+        header.flags |= ContainerHeader::DICTIONARY;
+        header.dictionaryId = state->dictionaryId;
+    }
+    //the STATIC algorithm is coded by either encoder, without their trees
+    HuffmanEncoder<unsigned char>& encoder = options.algorithm == VITTER ? state->vitterEncoder : state->fgkEncoder;
+    encoder.reset();
+    encoder.encode(header);
+    if (!state->output)
+        return state->fail("the output buffer is too small");
+    return state->outputBuffer.written();
+}
+
+std::size_t Context::decompress(const std::uint8_t* input, std::size_t size, std::uint8_t* output, std::size_t capacity) {
+    std::size_t length = decompressedSize(input, size);
+    if (length == FAILED)
+        return state->fail("the input is not compressed by huff, or is truncated");
+    if (length > capacity)
+        return state->fail("the output buffer is too small, " + std::to_string(length) + " bytes are needed");
+    state->open(input, size, output, capacity);
+    ContainerHeader header;
+    header.read(state->input);
+    if (header.algorithm != ContainerHeader::FGK && header.algorithm != ContainerHeader::VITTER &&
+        header.algorithm != ContainerHeader::STATIC)
+        return state->fail("unknown algorithm");
+    bool vitter = header.algorithm == ContainerHeader::VITTER;
+    if (vitter)
+        state->vitterDecodeTree.reset();
+    else
+        state->fgkDecodeTree.reset();
+    HuffmanDecoder<unsigned char>& decoder = vitter ? state->vitterDecoder : state->fgkDecoder;
+    if (!decoder.decode(header))
+        return state->fail(decoder.getError());
+    return state->outputBuffer.written();
+}
+
+bool Context::setDictionary(const std::uint8_t* dictionary, std::size_t size) {
+    state->error.clear();
+    Dictionary<unsigned char> read;
+    if (size != 0) {
+        MemoryBuffer buffer(reinterpret_cast<const char*>(dictionary), size);
+        std::istream stream(&buffer);
+        if (!read.read(stream)) {
+            state->fail("the input is not a dictionary of bytes, or is corrupt");
+            return false;
+        }
+    }
+    std::vector<int> weights = read.getWeights();
+    std::uint32_t id = size == 0 ? 0 : read.getId();
+    state->fgkEncodeTree.setPreset(weights, id);
+    state->fgkDecodeTree.setPreset(weights, id);
+    state->vitterEncodeTree.setPreset(weights, id);
+    state->vitterDecodeTree.setPreset(weights, id);
+    state->dictionaryId = id;
+    return true;
+}
+
+std::size_t Context::decompressedSize(const std::uint8_t* input, std::size_t size) {
+    //the length is in the footer, at the very end
+    MemoryBuffer buffer(reinterpret_cast<const char*>(input), size);
+    std::istream stream(&buffer);
+    ContainerHeader header;
+    ContainerFooter footer;
+    if (size < ContainerHeader::SIZE + BlockHeader::SIZE + ContainerFooter::SIZE || !header.read(stream))
+        return FAILED;
+    stream.seekg(-static_cast<std::streamoff>(ContainerFooter::SIZE), std::ios::end);
+    if (!footer.read(stream) || footer.originalLength > FAILED - 1)
+        return FAILED;
+    return static_cast<std::size_t>(footer.originalLength);
+}
+
+const std::string& Context::getError() {
+    return state->error;
+}
+
+std::vector<std::uint8_t> trainDictionary(const std::uint8_t* sample, std::size_t size) {
+    Dictionary<unsigned char> dictionary;
+    dictionary.train(sample, size);
+    if (dictionary.empty())
+        return std::vector<std::uint8_t>();
+    std::ostringstream output;
+    dictionary.write(output);
+    std::string bytes = output.str();
+    return std::vector<std::uint8_t>(bytes.begin(), bytes.end());
+}
+
+struct StreamCompressor::State {
+    std::unique_ptr<HuffmanTree<unsigned char>> tree;
+    StreamEncoder<unsigned char> encoder;
+
+    State(const ContainerHeader& header) : tree(makeTree(header)), encoder(*tree, header) {}
+};
+
+//make the header of a stream described by the options. a block size of zero would never end a block, so it is taken as
+//the default. the stream has no index, as one would grow with every sync point for as long as the stream lasts
+static ContainerHeader makeStreamHeader(const Options& options) {
+    Options adaptive = options.blockSize == 0 ? Options() : options;
+    if (adaptive.algorithm == STATIC)
+        adaptive.algorithm = FGK;
+    ContainerHeader header = makeHeader(adaptive);
+    header.flags |= ContainerHeader::UNINDEXED;
+    return header;
+}
+
+StreamCompressor::StreamCompressor(const Options& options) : state(new State(makeStreamHeader(options))) {}
+
+StreamCompressor::~StreamCompressor() {}
+
+bool StreamCompressor::feed(const std::uint8_t* input, std::size_t size) {
+    return state->encoder.feed(input, size);
+}
+
+void StreamCompressor::flush() {
+    state->encoder.flush();
+}
+
+void StreamCompressor::finish() {
+    state->encoder.finish();
+}
+
+std::size_t StreamCompressor::available() {
+    return state->encoder.available();
+}
+
+std::size_t StreamCompressor::drain(std::uint8_t* output, std::size_t capacity) {
+    return state->encoder.drain(reinterpret_cast<char*>(output), capacity);
+}
+
+struct StreamDecompressor::State {
+    StreamDecoder<unsigned char> decoder;
+
+    State() : decoder(makeTree) {}
+};
+
+StreamDecompressor::StreamDecompressor() : state(new State()) {}
+
+StreamDecompressor::~StreamDecompressor() {}
+
+bool StreamDecompressor::feed(const std::uint8_t* input, std::size_t size) {
+    return state->decoder.feed(reinterpret_cast<const char*>(input), size);
+}
+
+bool StreamDecompressor::isFinished() {
+    return state->decoder.isFinished();
+}
+
+std::size_t StreamDecompressor::available() {
+    return state->decoder.available();
+}
+
+std::size_t StreamDecompressor::drain(std::uint8_t* output, std::size_t capacity) {
+    return state->decoder.drain(output, capacity);
+}
+
+const std::string& StreamDecompressor::getError() {
+    return state->decoder.getError();
+}
+
+std::size_t compress(const std::uint8_t* input, std::size_t size, std::uint8_t* output, std::size_t capacity,
+                     const Options& options) {
+    Context context;
+    return context.compress(input, size, output, capacity, options);
+}
+
+std::size_t decompress(const std::uint8_t* input, std::size_t size, std::uint8_t* output, std::size_t capacity) {
+    Context context;
+    return context.decompress(input, size, output, capacity);
+}
+
+}
@@ -0,0 +1,160 @@
+#ifndef DATA_ENCODING_P01_HUFF_HPP
+#define DATA_ENCODING_P01_HUFF_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+ * The library interface to huff, compressing and decompressing buffers in memory. The compressed form is the same
+ * container as the huff program writes (see Container.hpp), so either can read what the other wrote.
+ */
+namespace huff {
+
+//returned in place of a size when compressing or decompressing fails
+const std::size_t FAILED = ~std::size_t(0);
+
+//the Huffman algorithm, as recorded in the container header. STATIC codes each block with a static canonical code
+//built for it, which is much faster than the adaptive algorithms but can only be used to compress whole buffers
+enum Algorithm {
+    FGK = 0,
+    VITTER = 1,
+    STATIC = 2
+};
+
+struct Options {
+    Algorithm algorithm;
+    //code each block with a new tree, costing a little compression but letting the blocks be decoded separately. the
+    //blocks of the STATIC algorithm are always independent
+    bool independent;
+    //the number of bytes in each block
+    std::uint32_t blockSize;
+    //halve the tree's weights whenever the symbols it has counted pass this many, so that the code follows recent data on
+    //inputs whose statistics drift. it is kept between 512 (twice the number of byte values, so that the tree is not
+    //rebuilt too often) and INT_MAX. 0 never rescales. unused by the STATIC algorithm
+    std::uint32_t rescaleThreshold;
+
+    Options() : algorithm(FGK), independent(false), blockSize(1 << 20), rescaleThreshold(0) {}
+};
+
+/*
+ * Compresses and decompresses buffers, keeping its code trees and working buffers from one call to the next so that a
+ * context used for many small payloads only allocates once. A context must only be used by one thread at a time.
+ */
+class Context {
+public:
+    Context();
+    ~Context();
+
+    Context(const Context&) = delete;
+    Context& operator=(const Context&) = delete;
+
+    //compress size bytes of input into the output, which has room for capacity bytes. returns the number of bytes
+    //written, or FAILED (with the reason given by getError) if the output is too small
+    std::size_t compress(const std::uint8_t* input, std::size_t size, std::uint8_t* output, std::size_t capacity,
+                         const Options& options = Options());
+
+    //decompress size bytes of compressed input into the output, which has room for capacity bytes. returns the number
+    //of bytes written, or FAILED (with the reason given by getError) if the input is not valid or the output is too small
+    std::size_t decompress(const std::uint8_t* input, std::size_t size, std::uint8_t* output, std::size_t capacity);
+
+    //start the adaptive trees from a dictionary made by trainDictionary, for both compressing and decompressing, until
+    //another is set. an input compressed with a dictionary can only be decompressed with the same one. a size of 0
+    //removes the dictionary. returns false, with the reason given by getError, if the input is not a dictionary
+    bool setDictionary(const std::uint8_t* dictionary, std::size_t size);
+
+    //return the number of bytes that the compressed input decompresses to, or FAILED if the input is not valid
+    static std::size_t decompressedSize(const std::uint8_t* input, std::size_t size);
+
+    //return the reason that the last call failed
+    const std::string& getError();
+
+private:
+    struct State;
+    std::unique_ptr<State> state;
+};
+
+//count the bytes of a sample of the data to be compressed into a dictionary for Context::setDictionary, the same as
+//huff --train makes. the dictionary is empty if the sample is
+std::vector<std::uint8_t> trainDictionary(const std::uint8_t* sample, std::size_t size);
+
+/*
+ * Compresses a long-lived stream fed in a piece at a time, such as the messages on a connection, with the code tree
+ * carrying on from one message to the next. The compressed stream is a container like any other, so once finished it
+ * can also be decompressed whole. The stream is always coded adaptively, with FGK in place of STATIC, and without a
+ * dictionary: its tree carries what it learns from one message to the next instead. It has no block index, so that
+ * memory use does not grow with the number of sync points, which means a finished stream can only be decompressed
+ * in order, never in parallel.
+ */
+class StreamCompressor {
+public:
+    StreamCompressor(const Options& options = Options());
+    ~StreamCompressor();
+
+    StreamCompressor(const StreamCompressor&) = delete;
+    StreamCompressor& operator=(const StreamCompressor&) = delete;
+
+    //compress size more bytes, returns false if the stream has already been finished
+    bool feed(const std::uint8_t* input, std::size_t size);
+
+    //make a sync point: once everything up to here is drained and fed to a StreamDecompressor, it can give back every
+    //byte fed in so far. each sync point costs a block header and up to a byte of padding
+    void flush();
+
+    //flush, then end the stream. nothing more can be fed in afterwards
+    void finish();
+
+    //return the number of compressed bytes ready to be drained
+    std::size_t available();
+
+    //move up to capacity compressed bytes into the output, returns the number moved
+    std::size_t drain(std::uint8_t* output, std::size_t capacity);
+
+private:
+    struct State;
+    std::unique_ptr<State> state;
+};
+
+/*
+ * Decompresses a stream written by StreamCompressor, fed in a piece at a time. Bytes become available to drain at each
+ * sync point, or every block if sooner.
+ */
+class StreamDecompressor {
+public:
+    StreamDecompressor();
+    ~StreamDecompressor();
+
+    StreamDecompressor(const StreamDecompressor&) = delete;
+    StreamDecompressor& operator=(const StreamDecompressor&) = delete;
+
+    //decompress as much as possible with size more compressed bytes. returns false, with the reason given by getError,
+    //if the stream is not valid
+    bool feed(const std::uint8_t* input, std::size_t size);
+
+    //return true once the end of the stream has been decompressed
+    bool isFinished();
+
+    //return the number of decompressed bytes ready to be drained
+    std::size_t available();
+
+    //move up to capacity decompressed bytes into the output, returns the number moved
+    std::size_t drain(std::uint8_t* output, std::size_t capacity);
+
+    //return the reason that the stream is not valid
+    const std::string& getError();
+
+private:
+    struct State;
+    std::unique_ptr<State> state;
+};
+
+//compress or decompress with a context of their own, see Context
+std::size_t compress(const std::uint8_t* input, std::size_t size, std::uint8_t* output, std::size_t capacity,
+                     const Options& options = Options());
+std::size_t decompress(const std::uint8_t* input, std::size_t size, std::uint8_t* output, std::size_t capacity);
+
+}
+
+#endif //DATA_ENCODING_P01_HUFF_HPP
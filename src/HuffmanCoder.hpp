@@ -4,18 +4,16 @@
 #include <vector>
 #include "HuffmanTree.hpp"
 #include "BitWriter.hpp"
-#include "Node.hpp"
 #include "BitReader.hpp"
+#include "Container.hpp"
+#include "MemoryBuffer.hpp"
 
 template<typename T>
 class HuffmanCoder {
 public:
-    HuffmanCoder(std::istream& input, std::ostream& output, HuffmanTree<T>& tree) : input(input), output(output), tree(tree) {
-
-    }
-
-    ~HuffmanCoder() {
-        output.flush();
+    HuffmanCoder(std::istream& input, std::ostream& output, HuffmanTree<T>& tree) : tree(tree), input(input), output(output) {
+        //input already in memory is coded where it lies, rather than being copied out of the stream
+        memory = dynamic_cast<MemoryBuffer*>(input.rdbuf());
     }
 
     HuffmanTree<T>& getTree() {
@@ -28,17 +26,10 @@ public:
 
 protected:
     HuffmanTree<T>& tree;
-    BitWriter<T> output;
-
-    //read a single char from the input stream
-    char readChar() {
-        char c;
-        input >> std::noskipws >> c;
-        return c;
-    }
-
-private:
     std::istream& input;
+    std::ostream& output;
+    //the input's buffer if the input is in memory, otherwise null
+    MemoryBuffer* memory;
 };
 
 #endif //DATA_ENCODING_P01_HUFFMANCODER_HPP
@@ -1,14 +1,25 @@
 #ifndef DATA_ENCODING_P01_HUFFMANDECODER_HPP
 #define DATA_ENCODING_P01_HUFFMANDECODER_HPP
 
-#include <assert.h>
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
 #include "HuffmanCoder.hpp"
 #include "BitReader.hpp"
 #include "HuffmanTree.hpp"
+#include "DecodeTable.hpp"
+#include "StaticCode.hpp"
+#include "Stats.hpp"
+#include "SliceOutput.hpp"
+#include "ThreadPool.hpp"
 
 template<typename T> class HuffmanDecoder : HuffmanCoder<T> {
     using HuffmanCoder<T>::tree;
+    using HuffmanCoder<T>::input;
     using HuffmanCoder<T>::output;
+    using HuffmanCoder<T>::memory;
     /*
      * Encoding procedure derived from figure 3.9,
      * Sayood, K. (2006). Introduction to data compression. Amsterdam: Elsevier, p64
@@ -34,89 +45,386 @@ template<typename T> class HuffmanDecoder : HuffmanCoder<T> {
      * -     ELSE
      * -         output the element corresponding to current node
      * -     CALL Update Procedure
-     * - WHILE not last bit
+     * - WHILE symbols remain in the block
      * - END
      */
 public:
     /*
      * Based on: Sayood, K. (2006). Introduction to data compression. Amsterdam: Elsevier, section 3.4, p58
      *
-     * E.g. for char based symbols, where m is the size of the alphabet:
-     * m = UCHAR_MAX
-     * e = CHAR_BIT - 1
-     * r = m - (1 << e)
+     * The NYT list holds m symbols, where m = 2^e + r and 0 <= r < 2^e. The first 2r symbols are sent in e + 1 bits,
+     * and the rest in e bits. The alphabet here is every value of T, so m is a power of two: e is the number of bits in
+     * T and r is zero, meaning every symbol is sent as its own value in full.
      *
      * The following constants: HUFF_SIZE, HUFF_EPSILON, HUFF_REMAINDER are analogous, respectively, to the variables above.
      * The constants are also general for all integral types up to and including long
      */
-    //the size of the default alphabet (the maximum possible value given integral type T); e.g. cast 0 to T, perform bitwise negation
-    static const unsigned long HUFF_SIZE = ~(T)0;
-    static const unsigned long HUFF_EPSILON = sizeof (T) * CHAR_BIT - 1;
-    static const unsigned long HUFF_REMAINDER = HUFF_SIZE - (1 << HUFF_EPSILON);
+    //the largest symbol, one less than the size of the alphabet
+    static const unsigned long HUFF_SIZE = static_cast<T>(~static_cast<T>(0));
+    static const unsigned long HUFF_EPSILON = sizeof (T) * CHAR_BIT;
+    static const unsigned long HUFF_REMAINDER = 0;
 
     //The implementation of HuffmanTree determines the update rule
-    HuffmanDecoder(std::istream& input, std::ostream& output, HuffmanTree<T>& tree) : HuffmanCoder<T>(input, output, tree), reader(input) {}
+    HuffmanDecoder(std::istream& input, std::ostream& output, HuffmanTree<T>& tree)
+            : HuffmanCoder<T>(input, output, tree), table(tree), staticBlocks(false) {}
 
-    //place the decoded data into the output bit-buffer
-    void decode() {
-        while (reader.nextBufferGood()) {
-            Node<NodeData<T>, 2> *node = &tree.getRoot();
-            T decoded = 0;
-            //if not a leaf traverse down using the read bit as the path until we get to a leaf
-            while (!node->isLeaf()) {
-                if (reader.read())
-                    node = node->child(1);
-                else
-                    node = node->child(0);
+    //creates a new, empty code tree for the algorithm being used
+    typedef std::function<HuffmanTree<T>*()> TreeFactory;
+
+    //decode the blocks of a container, the input being positioned just after the header. returns false, with the reason
+    //given by getError, if the input is not a whole and uncorrupted container
+    bool decode(const ContainerHeader& header) {
+        if (!checkHeader(header))
+            return false;
+        //with a seekable input the footer and index are checked before anything is decoded
+        bool indexed = header.isIndexed() && input.tellg() != std::streampos(-1);
+        if (indexed && !readIndex(header))
+            return false;
+        const char* code;
+        BlockHeader block;
+        while (readBlock(header, indexed, block, buffer, code)) {
+            std::uint32_t n = block.getSymbols(sizeof(T));
+            if (symbols.size() < n)
+                symbols.resize(n);
+            if (header.isIndependent())
+                tree.reset();
+            if (!decodeBlock(code, block.codedLength, symbols.data(), n))
+                return fail("block " + std::to_string(count - 1) + " is corrupt (invalid code)");
+            if (!block.checkData(symbols.data()))
+                return fail(mismatch(count - 1));
+            HUFF_TIME(STREAM_TIME);
+            output.write(reinterpret_cast<const char*>(symbols.data()), block.rawLength);
+        }
+        if (!error.empty())
+            return false;
+        //without a seekable input (or an index) the index and footer follow the blocks
+        if (!indexed) {
+            std::vector<char> indexBytes(header.isIndexed() ? static_cast<std::size_t>(count) * BlockIndexEntry::SIZE : 0);
+            if (!input.read(indexBytes.data(), indexBytes.size()) || !footer.read(input))
+                return fail("truncated input");
+            if (!BlockIndexEntry::parseIndex(indexBytes, footer.indexCrc, index))
+                return fail("corrupt block index");
+        }
+        return checkFooter();
+    }
+
+    //decode the blocks of a container with independent blocks, the input being seekable and positioned just after the
+    //header. the blocks are decoded on the pool's workers, each with its own tree from makeTree (or its own static code
+    //with the STATIC algorithm), and each worker writes its block straight to its own part of the output (which is not
+    //the decoder's output stream). returns false, with the reason given by getError, if the input is not a whole and
+    //uncorrupted container or the output fails
+    bool decode(const ContainerHeader& header, ThreadPool& pool, TreeFactory makeTree, SliceOutput& slices) {
+        if (!checkHeader(header))
+            return false;
+        if (!header.isIndependent())
+            return fail("the blocks are not independent, so cannot be decoded in parallel");
+        if (!header.isIndexed())
+            return fail("the blocks are not indexed, so cannot be decoded in parallel");
+        if (input.tellg() == std::streampos(-1))
+            return fail("the input must be seekable to decode in parallel");
+        if (!readIndex(header))
+            return false;
+        if (!slices.allocate(footer.originalLength))
+            return fail("failed to allocate the output");
+        //a few blocks per worker are read ahead of the ones being decoded
+        std::deque<std::shared_ptr<Job>> jobs;
+        std::uint64_t position = 0;
+        bool more = true, isStatic = staticBlocks;
+        int threshold = tree.getRescaleThreshold();
+        while (true) {
+            while (more && jobs.size() < 2 * pool.size()) {
+                std::shared_ptr<Job> job = std::make_shared<Job>();
+                if (!readBlock(header, true, job->block, job->buffer, job->code)) {
+                    more = false;
+                    break;
+                }
+                job->position = position;
+                job->name = "block " + std::to_string(count - 1);
+                job->mismatch = mismatch(count - 1);
+                position += job->block.rawLength;
+                job->done = pool.submit([job, makeTree, isStatic, threshold, &slices]() {
+                    std::uint64_t at = job->position;
+                    std::size_t n = job->block.getSymbols(sizeof(T));
+                    //the block is decoded straight into the output if it can be, otherwise it is written out after. a
+                    //block ending part way through a symbol has padding which must not reach the output
+                    std::vector<T> symbols;
+                    T* target = nullptr;
+                    if (job->block.rawLength % sizeof(T) == 0)
+                        target = reinterpret_cast<T*>(slices.map(at, job->block.rawLength));
+                    if (target == nullptr) {
+                        symbols.resize(n);
+                        target = symbols.data();
+                    }
+                    bool valid;
+                    if (isStatic)
+                        valid = StaticCode<T>().decodeBlock(job->code, job->block.codedLength, target, n);
+                    else {
+                        std::unique_ptr<HuffmanTree<T>> jobTree(makeTree());
+                        jobTree->setRescaleThreshold(threshold);
+                        DecodeTable<T> jobTable(*jobTree);
+                        valid = decodeBlock(*jobTree, jobTable, job->code, job->block.codedLength, target, n);
+                    }
+                    HUFF_TIME(STREAM_TIME);
+                    if (!valid)
+                        job->error = job->name + " is corrupt (invalid code)";
+                    else if (!job->block.checkData(target))
+                        job->error = job->mismatch;
+                    else if (!symbols.empty() && !slices.write(at, reinterpret_cast<const char*>(target), job->block.rawLength))
+                        job->error = "failed to write " + job->name;
+                });
+                jobs.push_back(job);
+            }
+            if (jobs.empty())
+                break;
+            std::shared_ptr<Job> job = jobs.front();
+            jobs.pop_front();
+            job->done.get();
+            //on an error, the jobs still queued finish before the pool is done with, so are waited for here
+            if (!job->error.empty() && error.empty()) {
+                error = job->error;
+                more = false;
             }
-            if (node == tree.getNYTNode()) {
-                decoded = decodeNYT();
-            } else {
-                decoded = node->getElement().value.value();
+        }
+        return error.empty() && checkFooter();
+    }
+
+    //decode only the size bytes starting at byte first, the input being seekable and positioned just after the
+    //header. the range is cut short at the end of the input. with independent and indexed blocks, decoding starts at the
+    //block holding the first byte, otherwise the tree has to be rebuilt from the start of the input, but decoding still
+    //stops once the range is done. returns false, with the reason given by getError, if the input is not valid
+    bool decodeRange(const ContainerHeader& header, std::uint64_t first, std::uint64_t size) {
+        if (!checkHeader(header))
+            return false;
+        if (input.tellg() == std::streampos(-1))
+            return fail("the input must be seekable to decode a range");
+        if (!readIndex(header))
+            return false;
+        if (first > footer.originalLength)
+            return fail("the range starts after the end of the input");
+        std::uint64_t last = first + std::min(size, footer.originalLength - first);
+        //find the block to start from, and the position of its first byte
+        std::uint64_t position = 0;
+        std::size_t start = 0;
+        while (header.isIndependent() && start < index.size() && position + index[start].rawLength <= first)
+            position += index[start++].rawLength;
+        if (start < index.size()) {
+            input.seekg(static_cast<std::streamoff>(index[start].offset));
+            count = static_cast<std::uint32_t>(start);
+            offset = index[start].offset;
+        }
+        tree.reset();
+        const char* code;
+        BlockHeader block;
+        while (position < last && readBlock(header, header.isIndexed(), block, buffer, code)) {
+            std::uint32_t n = block.getSymbols(sizeof(T));
+            if (symbols.size() < n)
+                symbols.resize(n);
+            if (header.isIndependent())
+                tree.reset();
+            //only as many of the last block's symbols as the range needs are decoded
+            std::uint64_t bytes = std::min<std::uint64_t>(block.rawLength, last - position);
+            n = static_cast<std::uint32_t>((bytes + sizeof(T) - 1) / sizeof(T));
+            if (!decodeBlock(code, block.codedLength, symbols.data(), n))
+                return fail("block " + std::to_string(count - 1) + " is corrupt (invalid code)");
+            //only a block decoded in full can be checked against the checksum of its input
+            if (bytes == block.rawLength && !block.checkData(symbols.data()))
+                return fail(mismatch(count - 1));
+            //write the part of the block inside the range
+            std::uint64_t from = std::max(first, position);
+            HUFF_TIME(STREAM_TIME);
+            if (from < position + bytes)
+                output.write(reinterpret_cast<const char*>(symbols.data()) + (from - position), position + bytes - from);
+            position += block.rawLength;
+        }
+        return error.empty();
+    }
+
+    //decode n symbols from size bytes of code into the symbols array, with the static code if the container being decoded
+    //uses the STATIC algorithm, otherwise with the tree. returns false if the code is not valid
+    bool decodeBlock(const char* code, std::size_t size, T* symbols, std::size_t n) {
+        if (staticBlocks)
+            return staticCode.decodeBlock(code, size, symbols, n);
+        return decodeBlock(tree, table, code, size, symbols, n);
+    }
+
+    //decode n symbols from size bytes of code into the symbols array with the tree, the table being kept for that tree.
+    //returns false if the code is not valid
+    static bool decodeBlock(HuffmanTree<T>& tree, DecodeTable<T>& table, const char* code, std::size_t size, T* symbols, std::size_t n) {
+        BitReader<T> reader(code, size);
+        HUFF_COUNT(SYMBOLS, n);
+        for (std::size_t i = 0; i < n; i++) {
+            T decoded = 0;
+            {
+                HUFF_TIME(BIT_TIME);
+                std::uint64_t start = reader.getBitsRead();
+                //resolve the first few bits of the path with the table
+                table.update();
+                const typename DecodeTable<T>::Entry& entry = table.lookup(reader.peekBits(DecodeTable<T>::BITS));
+                reader.consumeBits(entry.length);
+                unsigned long node = entry.node;
+                //if not a leaf traverse down using the read bit as the path until we get to a leaf
+                while (!tree.isLeaf(node))
+                    node = tree.getChild(node, reader.read());
+                HUFF_MAX(DEPTH, reader.getBitsRead() - start);
+                if (node == tree.getNYTIndex()) {
+                    HUFF_COUNT(ESCAPES, 1);
+                    decoded = decodeNYT(reader);
+                    //only a symbol which has not appeared yet is sent after the NYT code
+                    if (tree.hasSymbol(decoded))
+                        return false;
+                } else {
+                    decoded = tree.getSymbol(node);
+                }
+                //the code must not run past the end of the block
+                if (reader.getBitsRead() > size * CHAR_BIT)
+                    return false;
+                symbols[i] = decoded;
             }
-            output.template write<T>(decoded);
+            HUFF_TIME(UPDATE_TIME);
             tree.update(decoded);
         }
-        readRemaining();
+        return true;
+    }
+
+    //return the reason that decode last failed
+    const std::string& getError() {
+        return error;
     }
 
 protected:
-    //decode a character based on the predicate that we've seen the code for NYT
-    char decodeNYT() {
-        //read 'e' bits into p
-        T p = 0;
-        reader.read(HUFF_EPSILON, p);
+    //decode a symbol based on the predicate that we've seen the code for NYT
+    static T decodeNYT(BitReader<T>& reader) {
+        //read 'e' bits as p, with r being zero there is never another bit to read
+        std::uint64_t p = reader.readBits(HUFF_EPSILON);
         if (p < HUFF_REMAINDER)
-            reader.read(1, HUFF_EPSILON, p);
+            p = (p << 1) | reader.read();
         else
             p += HUFF_REMAINDER;
-        return p;
+        return static_cast<T>(p);
     }
 
-    //read, and interpret until the reader's buffer is empty (if it wasn't already)
-    void readRemaining() {
-        int remaining = reader.BITS - reader.getCurrentBit();
-        Node<NodeData<T>, 2> *node = &tree.getRoot();
-        while (remaining > 0) {
-            //read a bit
-            bool bit = reader.read() != 0;
-            if (!node->isLeaf())
-                node = node->child(bit);
-            else if (node == tree.getNYTNode()) {
-                //the nyt must return at this point because there is no possible way to output enough bits to fill another T
-                return;
-            }
-            //if after reading, the node is a leaf...
-            if (node->isLeaf()) {
-                output.template write<T>(node->getElement().value.value());
-                node = &tree.getRoot();
-            }
-            remaining--;
+private:
+    //a block being decoded by a worker
+    struct Job {
+        BlockHeader block;
+        //the block's code, which is in the buffer unless the input is in memory
+        std::vector<char> buffer;
+        const char* code;
+        //the position of the block's first byte in the output
+        std::uint64_t position;
+        std::string name, mismatch, error;
+        std::future<void> done;
+    };
+
+    DecodeTable<T> table;
+    //the code for the blocks of containers using the STATIC algorithm, which is used in place of the tree
+    StaticCode<T> staticCode;
+    bool staticBlocks;
+    //a block's symbols and code, kept from one decode to the next so that they are only allocated once
+    std::vector<T> symbols;
+    std::vector<char> buffer;
+    std::string error;
+    //the footer and index, and the blocks read so far with the offset of the next one in the input
+    ContainerFooter footer;
+    std::vector<BlockIndexEntry> index;
+    std::uint32_t count;
+    std::uint64_t offset, length;
+
+    bool fail(const std::string& reason) {
+        error = reason;
+        return false;
+    }
+
+    //return the error for a block which decodes to something other than the input that was coded
+    static std::string mismatch(std::uint32_t block) {
+        return "block " + std::to_string(block) + " does not decode to the input that was coded (checksum mismatch)";
+    }
+
+    //check that the header is one that can be decoded, and get ready to read the blocks after it
+    bool checkHeader(const ContainerHeader& header) {
+        error.clear();
+        count = 0;
+        offset = header.size();
+        length = 0;
+        staticBlocks = header.algorithm == ContainerHeader::STATIC;
+        if (header.version != ContainerHeader::VERSION)
+            return fail("unsupported version " + std::to_string(header.version));
+        if (!header.check())
+            return fail("corrupt header (checksum mismatch)");
+        if (header.symbolBits != sizeof(T) * CHAR_BIT)
+            return fail("unsupported symbol size of " + std::to_string(header.symbolBits) + " bits");
+        if (!header.checkRescaleThreshold())
+            return fail("unsupported rescale threshold of " + std::to_string(header.rescaleThreshold));
+        if (header.getDictionaryId() != tree.getPresetId() && header.algorithm != ContainerHeader::STATIC)
+            return fail(header.getDictionaryId() == 0 ? "the input was not compressed with a dictionary" :
+                        tree.getPresetId() == 0 ? "the input was compressed with a dictionary, which must be given" :
+                        "the input was compressed with a different dictionary");
+        tree.setRescaleThreshold(static_cast<int>(header.getRescaleThreshold()));
+        return true;
+    }
+
+    //read the footer and index from the end of the input, then go back to the start of the blocks. without an index,
+    //only the footer is read and the index is left empty
+    bool readIndex(const ContainerHeader& header) {
+        HUFF_TIME(STREAM_TIME);
+        std::streampos start = input.tellg();
+        input.seekg(0, std::ios::end);
+        std::streamoff size = input.tellg() - start;
+        if (size < static_cast<std::streamoff>(BlockHeader::SIZE + ContainerFooter::SIZE))
+            return fail("truncated input");
+        input.seekg(-static_cast<std::streamoff>(ContainerFooter::SIZE), std::ios::end);
+        if (!footer.read(input))
+            return fail("missing footer, the input may be truncated");
+        std::uint32_t entries = header.isIndexed() ? footer.blockCount : 0;
+        std::streamoff indexSize = static_cast<std::streamoff>(entries) * BlockIndexEntry::SIZE;
+        if (indexSize > size - static_cast<std::streamoff>(BlockHeader::SIZE + ContainerFooter::SIZE))
+            return fail("corrupt footer");
+        input.seekg(-static_cast<std::streamoff>(ContainerFooter::SIZE) - indexSize, std::ios::end);
+        if (!BlockIndexEntry::readIndex(input, entries, footer.indexCrc, index))
+            return fail("corrupt block index");
+        input.seekg(start);
+        return true;
+    }
+
+    //read the next block and its code, checking it against the index if there is one. the code is read into the buffer,
+    //unless the input is in memory in which case code points straight into it. returns false at the end of the blocks,
+    //or if the block is not valid (setting the error)
+    bool readBlock(const ContainerHeader& header, bool indexed, BlockHeader& block, std::vector<char>& buffer, const char*& code) {
+        HUFF_TIME(STREAM_TIME);
+        if (!block.read(input))
+            return fail("truncated input");
+        if (block.isEnd())
+            return false;
+        std::string name = "block " + std::to_string(count);
+        if (block.rawLength > std::uint64_t(header.blockSize) * sizeof(T))
+            return fail(name + " is larger than the block size");
+        if (indexed && (count >= index.size() || index[count].offset != offset || index[count].rawLength != block.rawLength))
+            return fail(name + " does not match the index");
+        if (memory != nullptr) {
+            if (memory->available() < block.codedLength)
+                return fail("truncated input");
+            code = memory->take(block.codedLength);
+        } else {
+            buffer.resize(block.codedLength);
+            if (!input.read(buffer.data(), buffer.size()))
+                return fail("truncated input");
+            code = buffer.data();
         }
+        if (!block.check(code))
+            return fail(name + " is corrupt (checksum mismatch)");
+        offset += BlockHeader::SIZE + block.codedLength;
+        length += block.rawLength;
+        count++;
+        HUFF_COUNT(CODE_BITS, std::uint64_t(block.codedLength) * CHAR_BIT);
+        return true;
     }
 
-private:
-    BitReader<T> reader;
+    //check that the blocks read match the footer
+    bool checkFooter() {
+        if (footer.blockCount != count || footer.originalLength != length)
+            return fail("the blocks do not match the footer");
+        return true;
+    }
 };
 
 #endif //DATA_ENCODING_P01_HUFFMANDECODER_HPP
@@ -1,12 +1,22 @@
 #ifndef DATA_ENCODING_P01_HUFFMANENCODER_HPP
 #define DATA_ENCODING_P01_HUFFMANENCODER_HPP
 
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
 #include "HuffmanTree.hpp"
 #include "HuffmanCoder.hpp"
+#include "StaticCode.hpp"
+#include "Stats.hpp"
+#include "ThreadPool.hpp"
 
 template <typename T> class HuffmanEncoder : public HuffmanCoder<T> {
+    using HuffmanCoder<T>::input;
     using HuffmanCoder<T>::output;
     using HuffmanCoder<T>::tree;
+    using HuffmanCoder<T>::memory;
     /*
      * Encoding procedure derived from figure 3.8,
      * Sayood, K. (2006). Introduction to data compression. Amsterdam: Elsevier, p62
@@ -25,26 +35,114 @@ template <typename T> class HuffmanEncoder : public HuffmanCoder<T> {
      */
 public:
     //The implementation of HuffmanTree determines the update rule
-    HuffmanEncoder(std::istream& input, std::ostream& output, HuffmanTree<T>& tree) : HuffmanCoder<T>(input, output, tree), reader(input) {}
-
-    //encode the next character from the input stream, place the encoded data in the output BitWriter (stores internally)
-    void encode() {
-        while (reader.nextBufferGood()) {
-            T c = reader.template read<T>();
-            if (!tree.findLeaf(c)) {
-                tree.outputPath(tree.getNYTNode(), output);
+    HuffmanEncoder(std::istream& input, std::ostream& output, HuffmanTree<T>& tree) : HuffmanCoder<T>(input, output, tree) {
+        tree.cacheCodes(true);
+    }
+
+    ~HuffmanEncoder() {
+        tree.cacheCodes(false);
+    }
+
+    //creates a new, empty code tree for the algorithm being used
+    typedef std::function<HuffmanTree<T>*()> TreeFactory;
+
+    //encode the whole input stream into a container (see Container.hpp) described by the header. the code tree carries
+    //on from one block to the next, unless the header says that the blocks are independent. with the STATIC algorithm
+    //the tree is unused, each block being given a static code of its own instead
+    void encode(const ContainerHeader& header) {
+        header.write(output);
+        offset = header.size();
+        tree.setRescaleThreshold(static_cast<int>(header.getRescaleThreshold()));
+        index.clear();
+        std::uint64_t length = 0;
+        const T* block;
+        while (std::uint32_t bytes = readBlock(header.blockSize, buffer, block)) {
+            code.clear();
+            if (header.algorithm == ContainerHeader::STATIC)
+                staticCode.encodeBlock(block, symbolsIn(bytes), code);
+            else {
+                if (header.isIndependent())
+                    tree.reset();
+                encodeBlock(tree, block, symbolsIn(bytes), code);
+            }
+            writeBlock(bytes, Crc32::compute(reinterpret_cast<const char*>(block), bytes), code);
+            length += bytes;
+        }
+        finish(length);
+    }
+
+    //encode the whole input stream into a container with independent blocks, coding the blocks on the pool's workers.
+    //each block is given its own tree from makeTree, or its own static code with the STATIC algorithm
+    void encode(ContainerHeader header, ThreadPool& pool, TreeFactory makeTree) {
+        header.flags |= ContainerHeader::INDEPENDENT;
+        bool isStatic = header.algorithm == ContainerHeader::STATIC;
+        int threshold = static_cast<int>(header.getRescaleThreshold());
+        header.write(output);
+        offset = header.size();
+        index.clear();
+        std::uint64_t length = 0;
+        //a few blocks per worker are read ahead, so that no worker waits on a block to be written out
+        std::deque<std::shared_ptr<Job>> jobs;
+        bool more = true;
+        while (true) {
+            while (more && jobs.size() < 2 * pool.size()) {
+                std::shared_ptr<Job> job = std::make_shared<Job>();
+                job->bytes = readBlock(header.blockSize, job->buffer, job->symbols);
+                if (job->bytes == 0) {
+                    more = false;
+                    break;
+                }
+                job->done = pool.submit([job, makeTree, isStatic, threshold]() {
+                    job->dataCrc = Crc32::compute(reinterpret_cast<const char*>(job->symbols), job->bytes);
+                    if (isStatic) {
+                        StaticCode<T>().encodeBlock(job->symbols, symbolsIn(job->bytes), job->code);
+                        return;
+                    }
+                    std::unique_ptr<HuffmanTree<T>> jobTree(makeTree());
+                    jobTree->cacheCodes(true);
+                    jobTree->setRescaleThreshold(threshold);
+                    encodeBlock(*jobTree, job->symbols, symbolsIn(job->bytes), job->code);
+                });
+                jobs.push_back(job);
+            }
+            if (jobs.empty())
+                break;
+            //the blocks are written out in order
+            std::shared_ptr<Job> job = jobs.front();
+            jobs.pop_front();
+            job->done.get();
+            writeBlock(job->bytes, job->dataCrc, job->code);
+            length += job->bytes;
+        }
+        finish(length);
+    }
+
+    //encode n symbols with the tree, appending the code to the end of the vector. the code is padded with zeroes to a
+    //whole byte
+    static void encodeBlock(HuffmanTree<T>& tree, const T* symbols, std::size_t n, std::vector<char>& code) {
+        BitWriter<T> bits(code);
+        for (std::size_t i = 0; i < n; i++)
+            encodeSymbol(tree, symbols[i], bits);
+        bits.flush();
+    }
+
+    //write the code for a symbol with the tree, then update the tree
+    static void encodeSymbol(HuffmanTree<T>& tree, T c, BitWriter<T>& bits) {
+        HUFF_COUNT(SYMBOLS, 1);
+        {
+            HUFF_TIME(BIT_TIME);
+            long length;
+            if (!tree.hasSymbol(c)) {
+                HUFF_COUNT(ESCAPES, 1);
+                length = tree.outputPath(tree.getNYTIndex(), bits);
                 //the NYT list itself is assumed to be the ASCII table, hence we write the code for the value of c
-                output.template write<T>(c);
+                bits.template write<T>(c);
             } else
-                tree.outputPath(c, output);
-            this->tree.update(c);
+                length = tree.outputPath(c, bits);
+            HUFF_MAX(DEPTH, length);
         }
-        /*
-         * end of the stream. To get around the issue of the byte buffer in BitWriter
-         * possibly not being complete, we output the NYT path (repeatedly) until the buffer is full. This way, the decoder
-         * will never reach a leaf in the last step and can safely assume that the stream has ended.
-         */
-        tree.outputPathUntilBufferFull(tree.getNYTNode(), output);
+        HUFF_TIME(UPDATE_TIME);
+        tree.update(c);
     }
 
     //reset the encoder by resetting the code tree
@@ -53,8 +151,70 @@ public:
     }
 
 private:
-    //use this to read individual bits from the input stream
-    BitReader<T> reader;
+    //a block being coded by a worker
+    struct Job {
+        //the block's symbols, which are in the buffer unless the input is in memory
+        std::vector<T> buffer;
+        const T* symbols;
+        std::uint32_t bytes, dataCrc;
+        std::vector<char> code;
+        std::future<void> done;
+    };
+
+    //the offset of the next block header in the output
+    std::uint64_t offset;
+    //a block's symbols and code, and the index of the blocks written, kept from one encode to the next so that they are
+    //only allocated once
+    std::vector<T> buffer;
+    std::vector<char> code;
+    std::vector<BlockIndexEntry> index;
+    StaticCode<T> staticCode;
+
+    //return the number of symbols holding the bytes, the last of which may be cut short
+    static std::size_t symbolsIn(std::uint32_t bytes) {
+        return (std::size_t(bytes) + sizeof(T) - 1) / sizeof(T);
+    }
+
+    //read up to size symbols from the input, pointing block at them, returns the number of bytes read. the symbols are
+    //read into the buffer, unless the input is in memory in which case block points straight into it. if the input ends
+    //part way through a symbol, that symbol is padded with zero bytes in the buffer
+    std::uint32_t readBlock(std::uint32_t size, std::vector<T>& buffer, const T*& block) {
+        HUFF_TIME(STREAM_TIME);
+        std::uint64_t capacity = std::uint64_t(size) * sizeof(T);
+        if (memory != nullptr) {
+            std::uint32_t bytes = static_cast<std::uint32_t>(std::min<std::uint64_t>(capacity, memory->available()));
+            block = reinterpret_cast<const T*>(memory->take(bytes));
+            if (bytes % sizeof(T) != 0) {
+                buffer.assign(symbolsIn(bytes), 0);
+                std::memcpy(buffer.data(), block, bytes);
+                block = buffer.data();
+            }
+            return bytes;
+        }
+        buffer.resize(size);
+        block = buffer.data();
+        input.read(reinterpret_cast<char*>(buffer.data()), capacity);
+        std::uint32_t bytes = static_cast<std::uint32_t>(input.gcount());
+        std::memset(reinterpret_cast<char*>(buffer.data()) + bytes, 0, symbolsIn(bytes) * sizeof(T) - bytes);
+        return bytes;
+    }
+
+    //write a block coding the given number of bytes of input, with the input's checksum, recording it in the index
+    void writeBlock(std::uint32_t bytes, std::uint32_t dataCrc, const std::vector<char>& code) {
+        HUFF_TIME(STREAM_TIME);
+        HUFF_COUNT(CODE_BITS, code.size() * CHAR_BIT);
+        BlockHeader::make(bytes, dataCrc, code.data(), static_cast<std::uint32_t>(code.size())).write(output);
+        output.write(code.data(), code.size());
+        index.push_back(BlockIndexEntry(offset, bytes));
+        offset += BlockHeader::SIZE + code.size();
+    }
+
+    //write the end of the blocks, the index and the footer
+    void finish(std::uint64_t length) {
+        BlockHeader().write(output);
+        std::uint32_t indexCrc = BlockIndexEntry::writeIndex(output, index);
+        ContainerFooter(length, static_cast<std::uint32_t>(index.size()), indexCrc).write(output);
+    }
 };
 
 #endif //DATA_ENCODING_P01_HUFFMANENCODER_HPP
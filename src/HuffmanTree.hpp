@@ -2,171 +2,569 @@
 #define DATA_ENCODING_P01_HUFFMANTREE_HPP
 
 #include <istream>
-#include <set>
+#include <ostream>
+#include <algorithm>
+#include <climits>
+#include <memory>
 #include <vector>
-#include <map>
-#include <stack>
-#include "NodeData.hpp"
-#include "Node.hpp"
+#include <cstdint>
 #include "BitWriter.hpp"
-#include "NodeData.hpp"
+#include "Block.hpp"
+#include "Container.hpp"
 
+/*
+ * The common interface to an adaptive code tree. How the tree is stored is left to the implementation class, nodes are
+ * instead referred to by their number in the sibling ordering: the root always holds the highest number, the NYT node
+ * always holds the lowest, and a node keeps its number for as long as it is in the tree.
+ *
+ * The blocks of equal weight nodes are kept here, as they only depend on the numbering and the key given to each node.
+ *
+ * Weights only ever grow, so on a long input the early statistics outweigh the recent ones and the code is slow to
+ * follow a change in the data. With a rescale threshold, every weight is halved once the root's weight passes it and
+ * the tree is rebuilt from the new weights, so the tree keeps up with the recent data (and the weights never overflow).
+ *
+ * A tree can also be given a preset, such as one trained on sample data (see Dictionary.hpp), which it starts from in
+ * place of the lone NYT node whenever it is reset. Symbols in the preset are coded without the NYT escape from the
+ * start, which on short inputs is most of the gain. The preset tree is worked out once, so a reset only copies it in.
+ *
+ * Both rescaled and preset trees are worked out here, see planTree, and applied by the implementation class.
+ *
+ * The whole adaptive state of a tree is its nodes from the NYT node up: their weights, and the child or symbol of each.
+ * save writes them as a snapshot which load makes any tree of the same kind back into, e.g. to checkpoint a model part
+ * way through a stream, and clone copies a tree outright so that several coders can carry on from one warmed up state.
+ * The settings of a tree (its rescale threshold, preset, and whether it caches codes or tracks changes) are not part of
+ * the state and are left as they are by load. The snapshot layout, every number being little-endian:
+ *
+ * "HUFT", version, symbol size in bits, 1 if leaves come first (see leavesFirst) else 0, a zero byte
+ * number of nodes, bytes of nodes, both 4 bytes
+ * nodes            from the one above the NYT node up to the root, each a number weight * 2 + 1 followed by its
+ *                  symbol (as many bytes as T) for a leaf, or weight * 2 followed by how many numbers below it its 0
+ *                  child is for an internal node. the numbers take 7 bits a byte, the low bits first, the top bit of
+ *                  each byte but the last being set
+ * CRC-32           of everything before it
+ */
 template<typename T> class HuffmanTree {
 public:
+    //the number of distinct symbols representable by T, i.e. the size of the symbol-indexed leaf table
+    static const unsigned long ALPHABET_SIZE = 1UL << (sizeof(T) * CHAR_BIT);
+    //marks a node number which is not in any block
+    static const unsigned long NO_BLOCK = ~0UL;
+    //the lowest rescale threshold, see ContainerHeader::minRescaleThreshold
+    static const int MIN_RESCALE_THRESHOLD = static_cast<int>(2 * ALPHABET_SIZE);
+
     HuffmanTree() {
-        //alphabet is specified, may have less elements than the full alphabet possible with char type
-        indices = std::map<Node<NodeData<T>, 2>*, unsigned long>();
-        //(~(T)0) is the maximum possible value (unsigned) of a given integral type
-        maxNodes = 2 * (~(T)0) - 1;
-        root = makeNYT();
-        reassignIndices();
+        //a full code tree has one leaf per symbol of the alphabet plus the NYT leaf, and one fewer internal nodes
+        maxNodes = 2 * ALPHABET_SIZE + 1;
+        tracking = false;
+        caching = false;
+        //there can never be more blocks than nodes
+        blocks = std::vector<Block>(maxNodes);
+        blockOf = std::vector<unsigned long>(maxNodes, NO_BLOCK);
+        nextBlock = 0;
+        rescaleThreshold = 0;
+        presetNYT = 0;
+        presetId = 0;
     }
 
-    ~HuffmanTree() {}
+    //copy the whole tree, sharing the preset rather than copying it
+    HuffmanTree(const HuffmanTree& other) : blocks(other.blocks), freeBlocks(other.freeBlocks), nextBlock(other.nextBlock),
+                                            blockOf(other.blockOf), preset(other.preset), presetNYT(other.presetNYT),
+                                            maxNodes(other.maxNodes), rescaleThreshold(other.rescaleThreshold),
+                                            presetId(other.presetId), tracking(other.tracking), changed(other.changed),
+                                            caching(other.caching), codes(other.codes), codeLengths(other.codeLengths) {}
+
+    HuffmanTree& operator=(const HuffmanTree&) = delete;
+
+    virtual ~HuffmanTree() {}
+
+    //return a new tree of the same kind, in the same state and with the same settings, defined by implementation class
+    virtual HuffmanTree<T>* clone() = 0;
 
     //update the tree, defined by implementation class
     virtual void update(T c) = 0;
 
-    //return a reference to the root of the tree
-    Node<NodeData<T>, 2>& getRoot() {
-        return root;
+    //reset the whole tree back to the initial root node, or to the preset tree if there is one
+    virtual void reset() = 0;
+
+    //return the number of the NYT node
+    virtual unsigned long getNYTIndex() = 0;
+
+    //return true if the numbered node has no children
+    virtual bool isLeaf(unsigned long node) = 0;
+
+    //return the number of the numbered node's child on the side given by bit
+    virtual unsigned long getChild(unsigned long node, int bit) = 0;
+
+    //return the number of the numbered node's parent, the root has no parent
+    virtual unsigned long getParent(unsigned long node) = 0;
+
+    //return the symbol held by the numbered leaf, not useful for internal nodes or the NYT node
+    virtual T getSymbol(unsigned long node) = 0;
+
+    //return the weight of the numbered node
+    virtual int getWeight(unsigned long node) = 0;
+
+    //return true if the symbol has appeared, i.e. it has a leaf in the tree
+    virtual bool hasSymbol(T symbol) = 0;
+
+    //return the number of the symbol's leaf, not useful if the symbol has not appeared yet
+    virtual unsigned long getLeafIndex(T symbol) = 0;
+
+    //halve every weight and rebuild the tree from the new weights, defined by implementation class. the tree keeps the
+    //same symbols and the same number of nodes
+    virtual void rescale() = 0;
+
+    //rescale the tree whenever an update takes the root's weight past the threshold, or never if it is 0 (the default).
+    //a threshold below MIN_RESCALE_THRESHOLD is raised to it. the encoder and decoder must use the same threshold. it is
+    //kept when the tree is reset
+    void setRescaleThreshold(int threshold) {
+        rescaleThreshold = threshold == 0 ? 0 : std::max(threshold, MIN_RESCALE_THRESHOLD);
     }
 
-    //output the path to the leaf value, return length of the path
-    long outputPath(T leafValue, BitWriter<T>& output) {
-        std::vector<T> path = std::vector<T>();
-        //find a leaf with the leaf value
-        Node<NodeData<T>, 2>* node = root.findLeaf([leafValue](NodeData<T> data) {
-            return data.value.exists() && data.value.value() == leafValue;
-        });
-        return outputPath(node, output);
+    int getRescaleThreshold() {
+        return rescaleThreshold;
     }
 
-    //output the path to take to get to the node, return the length of the path (in bits)
-    long outputPath(Node<NodeData<T>, 2>* node, BitWriter<T>& output) {
-        if (node != nullptr) {
-            Node<NodeData<T>, 2>* parent = node->getParent();
-            int n = 0;
-            std::stack<char> path = std::stack<char>();
-            while (parent != nullptr) {
-                //going up the tree, store a bit representing which path to take if the tree was being traversed downwards
-                if (node == parent->child(0))
-                    path.push(0);
-                else if (node == parent->child(1))
-                    path.push(1);
-                n++;
-                //set the node to the parent, and the parent to the next parent up the hierarchy
-                node = parent;
-                parent = node->getParent();
-            }
-            //output the path itself
-            while (!path.empty()) {
-                char bit = path.top();
-                output.writeBit(bit);
-                path.pop();
-            }
-            return n;
+    //start the tree from a preset, here and whenever it is reset: a Huffman tree of the symbols with nonzero weights (the
+    //weights being indexed by symbol), as though each had been seen that many times. the id names the preset, so that a
+    //decoder can check that it starts from the same tree as the encoder did. no weights removes the preset
+    void setPreset(const std::vector<int>& weights, std::uint32_t id) {
+        std::vector<std::pair<int, T>> leaves;
+        for (unsigned long s = 0; s < std::min<unsigned long>(weights.size(), ALPHABET_SIZE); s++) {
+            if (weights[s] > 0)
+                leaves.push_back(std::make_pair(weights[s], static_cast<T>(s)));
         }
-        return 0;
-    }
-
-    //output the path of the passed node, so long as the BitWriter has internal buffer space.
-    long outputPathUntilBufferFull(Node<NodeData<T>, 2>* node, BitWriter<T>& output) {
-        if (node != nullptr) {
-            Node<NodeData<T>, 2>* parent = node->getParent();
-            int n = 0;
-            std::stack<char> path = std::stack<char>();
-            while (parent != nullptr) {
-                //going up the tree, store a bit representing which path to take if the tree was being traversed downwards
-                if (node == parent->child(0))
-                    path.push(0);
-                else if (node == parent->child(1))
-                    path.push(1);
-                n++;
-                //set the node to the parent, and the parent to the next parent up the hierarchy
-                node = parent;
-                parent = node->getParent();
-            }
-            //output the path itself
-            std::stack<char> pathCopy = std::stack<char>(path);
-            for (std::stack<char> pathCopy = std::stack<char>(path); !pathCopy.empty() && output.getCurrentBit(); pathCopy = std::stack<char>(path)) {
-                output.writeBit(path.top());
-                path.pop();
-            }
-            return n;
+        preset.reset();
+        if (!leaves.empty()) {
+            std::shared_ptr<Plan> plan(new Plan());
+            presetNYT = planTree(leaves, *plan);
+            preset = plan;
         }
-        return 0;
-    }
-
-    //get the NYT node, returns null if the indices list has no non-null elements
-    Node<NodeData<T>, 2>* getNYTNode() {
-        Node<NodeData<T>, 2>* nyt = nullptr;
-        //the nyt node should be the first non-null node in the indices list (the lowest index), where the root is the highest
-        for (const auto &pair : indices) {
-            Node<NodeData<T>, 2>* node = pair.first;
-            if (node != nullptr && !node->getElement().value.exists() && node->getElement().weight == 0) {
-                nyt = pair.first;
-                break;
+        presetId = leaves.empty() ? 0 : id;
+        reset();
+    }
+
+    //return the id of the preset, or 0 if there is none
+    std::uint32_t getPresetId() {
+        return presetId;
+    }
+
+    //write a snapshot of the tree's state
+    void save(std::ostream& output) {
+        std::vector<char> bytes(SNAPSHOT_HEADER_SIZE, 0);
+        bytes.reserve(SNAPSHOT_HEADER_SIZE + getNodeCount() * (sizeof(T) + 10) + 4);
+        std::memcpy(bytes.data(), "HUFT", 4);
+        bytes[4] = static_cast<char>(SNAPSHOT_VERSION);
+        bytes[5] = static_cast<char>(sizeof(T) * CHAR_BIT);
+        bytes[6] = static_cast<char>(leavesFirst() ? 1 : 0);
+        LittleEndian::put(bytes.data() + 8, getNodeCount(), 4);
+        for (unsigned long node = getNYTIndex() + 1; node <= getRootIndex(); node++) {
+            std::uint64_t weight = static_cast<std::uint64_t>(getWeight(node));
+            if (isLeaf(node)) {
+                putNumber(bytes, weight * 2 + 1);
+                char symbol[sizeof(T)];
+                LittleEndian::put(symbol, getSymbol(node), sizeof(T));
+                bytes.insert(bytes.end(), symbol, symbol + sizeof(T));
+            } else {
+                putNumber(bytes, weight * 2);
+                putNumber(bytes, node - getChild(node, 0));
             }
         }
-        return nyt;
+        LittleEndian::put(bytes.data() + 12, bytes.size() - SNAPSHOT_HEADER_SIZE, 4);
+        char crc[4];
+        LittleEndian::put(crc, Crc32::compute(bytes.data(), bytes.size()), 4);
+        bytes.insert(bytes.end(), crc, crc + 4);
+        output.write(bytes.data(), bytes.size());
     }
 
-    //search for leaves by predicate
-    Node<NodeData<T>, 2>* findLeaf(std::function<bool(NodeData<T>)> predicate) {
-        return root.findLeaf(predicate);
+    //make the tree the one in a snapshot written by save from a tree of the same kind. returns false, leaving the tree as
+    //it was, if the input is not such a snapshot or is corrupt
+    bool load(std::istream& input) {
+        char header[SNAPSHOT_HEADER_SIZE];
+        if (!input.read(header, SNAPSHOT_HEADER_SIZE) || std::memcmp(header, "HUFT", 4) != 0 ||
+            header[4] != SNAPSHOT_VERSION || static_cast<unsigned char>(header[5]) != sizeof(T) * CHAR_BIT ||
+            header[6] != (leavesFirst() ? 1 : 0))
+            return false;
+        std::uint64_t count = LittleEndian::get(header + 8, 4), size = LittleEndian::get(header + 12, 4);
+        //a tree always has an odd number of nodes, and each node takes at least two bytes and at most ten plus a symbol
+        if (count % 2 == 0 || count > maxNodes || size < 2 * (count - 1) || size > (count - 1) * (sizeof(T) + 10))
+            return false;
+        std::vector<char> bytes(static_cast<std::size_t>(size) + 4);
+        if (!input.read(bytes.data(), bytes.size()))
+            return false;
+        std::uint32_t crc = Crc32::update(Crc32::compute(header, SNAPSHOT_HEADER_SIZE), bytes.data(), bytes.size() - 4);
+        if (crc != LittleEndian::get(bytes.data() + bytes.size() - 4, 4))
+            return false;
+        unsigned long lowest = getRootIndex() - static_cast<unsigned long>(count - 1);
+        if (!readSnapshot(bytes.data(), bytes.data() + size, lowest, rescaled))
+            return false;
+        restore(rescaled, lowest);
+        return true;
     }
 
-    //search for leaves by symbol
-    Node<NodeData<T>, 2>* findLeaf(T symbol) {
-        //find a leaf such that it's value exists and equals symbol
-        return findLeaf([symbol](NodeData<T> data) {
-           return data.value.exists() && data.value.value() == symbol;
-        });
+    //return the number of the root
+    unsigned long getRootIndex() {
+        return maxNodes - 1;
     }
 
-    //reset the whole tree back to the initial root node
-    void reset() {
-        root = makeNYT();
+    //output the path to the leaf value, return length of the path
+    long outputPath(T leafValue, BitWriter<T>& output) {
+        if (!caching)
+            return outputPath(getLeafIndex(leafValue), output);
+        if (codeLengths[leafValue] == 0) {
+            unsigned long node = getLeafIndex(leafValue);
+            std::uint64_t code;
+            unsigned n = getPath(node, code);
+            //paths longer than 64 bits are not cached
+            if (node != getRootIndex())
+                return outputPath(getLeafIndex(leafValue), output);
+            codes[leafValue] = code;
+            codeLengths[leafValue] = static_cast<unsigned char>(n);
+        }
+        output.writeBits(codes[leafValue], codeLengths[leafValue]);
+        return codeLengths[leafValue];
     }
 
-    //return the indices map
-    std::map<Node<NodeData<T>, 2>*, unsigned long> getIndices() {
-        return indices;
+    //output the path to take to get to the node, return the length of the path (in bits)
+    long outputPath(unsigned long node, BitWriter<T>& output) {
+        std::uint64_t code;
+        unsigned n = getPath(node, code);
+        long length = n;
+        //a path longer than 64 bits is written in pieces, the part nearest the root first
+        if (node != getRootIndex())
+            length += outputPath(node, output);
+        output.writeBits(code, n);
+        return length;
     }
 
-protected:
-    Node<NodeData<T>, 2> root;
-    std::map<Node<NodeData<T>, 2>*, unsigned long> indices;
+    //the number of nodes currently in the tree, the NYT node always holds the lowest number
+    unsigned long getNodeCount() {
+        return getMaxNodes() - getNYTIndex();
+    }
 
-    //make an NYT node, with the weight set to 0 and the optional set to non-existent
-    static Node<NodeData<T>, 2> makeNYT() {
-        NodeData<T> data = NodeData<T> { 0, Optional<T>() };
-        return Node<NodeData<T>, 2>(data);
+    //start or stop caching the code of each symbol, for writing repeated symbols without walking the tree
+    void cacheCodes(bool cache) {
+        caching = cache;
+        codes.assign(caching ? ALPHABET_SIZE : 0, 0);
+        codeLengths.assign(caching ? ALPHABET_SIZE : 0, 0);
     }
 
-    //search for all nodes with a specific weight group
-    std::vector<Node<NodeData<T>, 2>*> findWeightGroup(int weight) {
-        return root.findAllMatching([weight](NodeData<T> data) {
-            return data.weight == weight;
-        });
+    //start or stop recording which nodes have their children changed by updates, see getChanged
+    void trackChanges(bool track) {
+        tracking = track;
+        changed.clear();
+        if (tracking)
+            touchAll();
+    }
+
+    //the nodes which have had their children changed (or gained or lost children) since the last call to clearChanged,
+    //if changes are being tracked. the shape of the tree only differs below these nodes, a reset of the tree is
+    //recorded as a change to the root
+    const std::vector<unsigned long>& getChanged() {
+        return changed;
+    }
+
+    void clearChanged() {
+        changed.clear();
     }
 
     //return the maximum number of nodes that the alphabet, defined by T, can produce in the code tree
-    //i.e. 2 * <size of alphabet> - 1;
+    //i.e. 2 * (<size of alphabet> + 1) - 1, as the NYT leaf is never removed
     unsigned long getMaxNodes() {
         return maxNodes;
     }
 
-    void reassignIndices() {
-        this->indices = std::map<Node<NodeData<T>, 2>*, unsigned long>();
-        root.levelTraverseRTL([this](Node<NodeData<T>, 2>* node, long i) {
-            this->indices[node] = getMaxNodes() - i;
+protected:
+    //a node of a tree made by planTree: its weight, and its 0 child (the 1 child being the number above) or the symbol it
+    //holds
+    struct PlannedNode {
+        int weight;
+        bool leaf;
+        unsigned long child;
+        T symbol;
+    };
+
+    typedef std::vector<PlannedNode> Plan;
+
+    //pool of blocks of equal weight nodes, the stack of pool entries which have been freed, and the first entry which has
+    //not been used at all since the last reset
+    std::vector<Block> blocks;
+    std::vector<unsigned long> freeBlocks;
+    unsigned long nextBlock;
+    //the block that each node belongs to, indexed by node number
+    std::vector<unsigned long> blockOf;
+
+    //the tree made for rescale (or read by load), and the preset tree that a reset starts from (null if there is none)
+    //with the number of its NYT node, each indexed by node number. the preset is shared by clones, as it never changes
+    Plan rescaled;
+    std::shared_ptr<const Plan> preset;
+    unsigned long presetNYT;
+
+    //make the tree the planned one (see planTree), whatever it held before, defined by implementation class
+    virtual void restore(const Plan& plan, unsigned long lowest) = 0;
+
+    //return true if the leaves must come before the internal nodes of the same weight, for trees made by planTree
+    virtual bool leavesFirst() {
+        return false;
+    }
+
+    //return true if the last update took the root's weight past the rescale threshold, to be checked by the
+    //implementation class at the end of each update
+    bool needsRescale() {
+        return rescaleThreshold != 0 && getWeight(getRootIndex()) > rescaleThreshold;
+    }
+
+    //work out the tree for rescale, in which each leaf's weight is halved, rounding up so that no symbol drops to zero
+    void planRescale() {
+        std::vector<std::pair<int, T>> leaves;
+        for (unsigned long node = getNYTIndex() + 1; node <= getRootIndex(); node++) {
+            if (isLeaf(node))
+                leaves.push_back(std::make_pair(getWeight(node) / 2 + getWeight(node) % 2, getSymbol(node)));
+        }
+        planTree(leaves, rescaled);
+    }
+
+    //work out a Huffman tree with a leaf for each of the weighted symbols plus the NYT leaf, filling in plan for the nodes
+    //numbered from the NYT node up to the root, and return the number of the NYT node. the tree is built by merging the
+    //two lightest nodes in turn, and the nodes are numbered in the order they are merged, which is in order of weight
+    //with siblings next to each other, so the tree has the sibling property. the NYT node, with no weight, has the lowest
+    //number. among nodes of equal weight the leaves come first if leavesFirst returns true (Vitter's invariant), otherwise the
+    //merged nodes do, which keeps the NYT node's parent directly above its sibling as FGK expects
+    unsigned long planTree(std::vector<std::pair<int, T>> leaves, Plan& plan) {
+        //the leaves in order of weight, those of equal weight staying in the order given, after the NYT node
+        std::stable_sort(leaves.begin(), leaves.end(), [](const std::pair<int, T>& a, const std::pair<int, T>& b) {
+            return a.first < b.first;
         });
+        leaves.insert(leaves.begin(), std::make_pair(0, T()));
+        //the leaves are nodes 0 to m - 1, and merged node i is node m + i. merging takes the lightest node from the front
+        //of one of the two queues, and the nodes are numbered as they are taken, the root being the last made
+        std::size_t m = leaves.size();
+        unsigned long lowest = getRootIndex() - (2 * m - 2);
+        bool ties = leavesFirst();
+        plan.resize(maxNodes);
+        std::vector<int> weights(2 * m - 1, 0);
+        std::vector<unsigned long> children(2 * m - 1, 0);
+        for (std::size_t i = 0; i < m; i++)
+            weights[i] = leaves[i].first;
+        auto place = [&](std::size_t node, unsigned long number) {
+            PlannedNode& planned = plan[number];
+            planned.weight = weights[node];
+            planned.leaf = node < m;
+            planned.child = children[node];
+            planned.symbol = node < m ? leaves[node].second : T();
+        };
+        unsigned long number = lowest;
+        std::size_t leaf = 0, merged = m;
+        for (std::size_t next = m; next < 2 * m - 1; next++) {
+            for (int k = 0; k < 2; k++) {
+                bool takeLeaf = leaf < m && (merged == next || weights[leaf] < weights[merged] ||
+                                             (ties && weights[leaf] == weights[merged]));
+                std::size_t node = takeLeaf ? leaf++ : merged++;
+                weights[next] += weights[node];
+                place(node, number++);
+            }
+            children[next] = number - 2;
+        }
+        place(2 * m - 2, number);
+        return lowest;
+    }
+
+    //record that the numbered node's children have changed, to be called by the implementation class
+    void touch(unsigned long node) {
+        if (tracking)
+            changed.push_back(node);
+    }
+
+    //record that the whole tree has changed, to be called by the implementation class when the tree is reset
+    void touchAll() {
+        if (tracking) {
+            changed.clear();
+            changed.push_back(getRootIndex());
+        }
+        if (caching)
+            std::fill(codeLengths.begin(), codeLengths.end(), 0);
+    }
+
+    //forget the cached codes of every symbol below the numbered node, to be called by the implementation class once
+    //the node's contents (the symbol or the subtree) have moved there
+    void invalidateCodes(unsigned long node) {
+        if (!caching)
+            return;
+        //the subtree is walked with a stack rather than by recursing, as with a wide alphabet it may be very deep
+        pending.push_back(node);
+        while (!pending.empty()) {
+            node = pending.back();
+            pending.pop_back();
+            if (!isLeaf(node)) {
+                pending.push_back(getChild(node, 0));
+                pending.push_back(getChild(node, 1));
+            } else if (node != getNYTIndex())
+                codeLengths[getSymbol(node)] = 0;
+        }
+    }
+
+    //find the path from the node up to the root, or up to 64 bits of it. the bits are placed in code, the bit nearest the
+    //root being the most significant, and node is left at the point where the walk stopped. returns the number of bits
+    unsigned getPath(unsigned long& node, std::uint64_t& code) {
+        unsigned n = 0;
+        code = 0;
+        while (node != getRootIndex() && n < 64) {
+            //going up the tree, store a bit representing which path to take if the tree was being traversed downwards
+            unsigned long parent = getParent(node);
+            if (getChild(parent, 1) == node)
+                code |= std::uint64_t(1) << n;
+            n++;
+            node = parent;
+        }
+        return n;
+    }
+
+    //empty every block, to be called when the implementation class resets the tree. only the nodes numbered from lowest
+    //up (the NYT node's number before the reset) can be in a block, so the rest are left alone
+    void resetBlocks(unsigned long lowest) {
+        freeBlocks.clear();
+        nextBlock = 0;
+        std::fill(blockOf.begin() + lowest, blockOf.end(), NO_BLOCK);
+    }
+
+    //return the number of the highest numbered node with the same key as the numbered node
+    unsigned long getBlockLeader(unsigned long node) {
+        return blocks[blockOf[node]].leader;
+    }
+
+    //return the key of the block directly above the numbered node, or -1 if there is no such block
+    long getKeyAbove(unsigned long node) {
+        if (node + 1 >= getMaxNodes() || blockOf[node + 1] == NO_BLOCK)
+            return -1;
+        return blocks[blockOf[node + 1]].key;
+    }
+
+    //put a node into the block directly above it if the keys match, otherwise the node leads a new block of its own.
+    //the nodes above must already be in their blocks, and the node must not be in any block.
+    void joinBlock(unsigned long node, long key) {
+        if (getKeyAbove(node) == key) {
+            blockOf[node] = blockOf[node + 1];
+        } else {
+            //blocks which have been freed are used again before any which have never been used
+            if (freeBlocks.empty()) {
+                blockOf[node] = nextBlock++;
+            } else {
+                blockOf[node] = freeBlocks.back();
+                freeBlocks.pop_back();
+            }
+            blocks[blockOf[node]] = Block(key, node);
+        }
+    }
+
+    //take a node which leads its block out of the block, ready for its weight to change
+    void leaveBlock(unsigned long node) {
+        unsigned long block = blockOf[node];
+        //the leader is the highest numbered node, so if the node below is not in the block then the block is now empty
+        if (node == 0 || blockOf[node - 1] != block)
+            freeBlocks.push_back(block);
+        else
+            blocks[block].leader = node - 1;
+        blockOf[node] = NO_BLOCK;
+    }
+
+    //move the whole block directly above the node down by one number, so that the block now starts at the node. the node
+    //must not be in any block. returns the number freed at the top of the block, which is not in any block either
+    unsigned long shiftBlockDown(unsigned long node) {
+        unsigned long block = blockOf[node + 1];
+        unsigned long top = blocks[block].leader;
+        blockOf[node] = block;
+        blockOf[top] = NO_BLOCK;
+        blocks[block].leader = top - 1;
+        return top;
     }
 
 private:
+    static const char SNAPSHOT_VERSION = 1;
+    static const std::size_t SNAPSHOT_HEADER_SIZE = 16;
+
     unsigned long maxNodes;
+    int rescaleThreshold;
+    std::uint32_t presetId;
+    //nodes whose children have changed, only recorded when tracking is on
+    bool tracking;
+    std::vector<unsigned long> changed;
+    //the code of each symbol, and its length in bits (zero if not known), only kept when caching is on
+    bool caching;
+    std::vector<std::uint64_t> codes;
+    std::vector<unsigned char> codeLengths;
+    //the nodes still to be visited by invalidateCodes
+    std::vector<unsigned long> pending;
+
+    //append a number to a snapshot, 7 bits a byte
+    static void putNumber(std::vector<char>& bytes, std::uint64_t value) {
+        while (value >= 0x80) {
+            bytes.push_back(static_cast<char>(0x80 | (value & 0x7F)));
+            value >>= 7;
+        }
+        bytes.push_back(static_cast<char>(value));
+    }
+
+    //read a number of a snapshot from p, which is left after it. returns false if the number is cut off or too large
+    static bool getNumber(const char*& p, const char* end, std::uint64_t& value) {
+        value = 0;
+        for (int shift = 0; p != end && shift < 64; shift += 7) {
+            unsigned char byte = static_cast<unsigned char>(*p++);
+            value |= std::uint64_t(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+    //read the nodes of a snapshot into plan, the NYT node being numbered lowest. returns false unless they make up a
+    //tree with the sibling property: each node is the child of just one node above it (the root of none), each internal
+    //node weighs what its children do together, the weights only grow going up the numbers, and each symbol appears once
+    bool readSnapshot(const char* p, const char* end, unsigned long lowest, Plan& plan) {
+        plan.resize(maxNodes);
+        plan[lowest] = PlannedNode{0, true, 0, T()};
+        std::vector<bool> hasParent(maxNodes, false), seen(ALPHABET_SIZE, false);
+        for (unsigned long node = lowest + 1; node <= getRootIndex(); node++) {
+            PlannedNode& planned = plan[node];
+            std::uint64_t value;
+            if (!getNumber(p, end, value) || value / 2 > INT_MAX)
+                return false;
+            planned.weight = static_cast<int>(value / 2);
+            planned.leaf = value % 2 == 1;
+            planned.child = 0;
+            planned.symbol = T();
+            if (planned.leaf) {
+                if (end - p < static_cast<std::ptrdiff_t>(sizeof(T)) || planned.weight == 0)
+                    return false;
+                planned.symbol = static_cast<T>(LittleEndian::get(p, sizeof(T)));
+                p += sizeof(T);
+                if (seen[planned.symbol])
+                    return false;
+                seen[planned.symbol] = true;
+            } else {
+                std::uint64_t below;
+                if (!getNumber(p, end, below) || below < 2 || below > node - lowest)
+                    return false;
+                planned.child = node - static_cast<unsigned long>(below);
+                if (hasParent[planned.child] || hasParent[planned.child + 1] ||
+                    std::int64_t(plan[planned.child].weight) + plan[planned.child + 1].weight != planned.weight)
+                    return false;
+                hasParent[planned.child] = hasParent[planned.child + 1] = true;
+            }
+            const PlannedNode& below = plan[node - 1];
+            if (below.weight > planned.weight ||
+                (leavesFirst() && below.weight == planned.weight && !below.leaf && planned.leaf))
+                return false;
+        }
+        //every node but the root has a parent, so following the parents up from any node leads to the root
+        return p == end && std::count(hasParent.begin() + lowest, hasParent.end(), true) ==
+                           static_cast<std::ptrdiff_t>(getRootIndex() - lowest);
+    }
 };
 
+template<typename T> const unsigned long HuffmanTree<T>::ALPHABET_SIZE;
+template<typename T> const unsigned long HuffmanTree<T>::NO_BLOCK;
+template<typename T> const int HuffmanTree<T>::MIN_RESCALE_THRESHOLD;
+template<typename T> const char HuffmanTree<T>::SNAPSHOT_VERSION;
+template<typename T> const std::size_t HuffmanTree<T>::SNAPSHOT_HEADER_SIZE;
+
 #endif //DATA_ENCODING_P01_HUFFMANTREE_HPP
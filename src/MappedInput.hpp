@@ -0,0 +1,58 @@
+#ifndef DATA_ENCODING_P01_MAPPEDINPUT_HPP
+#define DATA_ENCODING_P01_MAPPEDINPUT_HPP
+
+#include <cstddef>
+#include <istream>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "MemoryBuffer.hpp"
+
+/*
+ * A whole file mapped into memory to be read, and an istream reading it. Only regular files can be mapped, so isOpen
+ * must be checked, and pipes and the like read through an ifstream instead.
+ */
+class MappedInput : public std::istream {
+public:
+    //map the file, check isOpen to see if this succeeded
+    MappedInput(const std::string& path) : std::istream(nullptr), data(nullptr), size(0), memory(nullptr, 0) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return;
+        struct stat info;
+        if (::fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) {
+            size = static_cast<std::size_t>(info.st_size);
+            //an empty file cannot be mapped, but needs no memory anyway
+            void* mapped = size == 0 ? nullptr : ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED) {
+                data = static_cast<const char*>(mapped);
+                if (data != nullptr)
+                    ::madvise(mapped, size, MADV_SEQUENTIAL);
+                memory.assign(size == 0 ? "" : data, size);
+                rdbuf(&memory);
+            }
+        }
+        ::close(fd);
+    }
+
+    ~MappedInput() {
+        if (data != nullptr)
+            ::munmap(const_cast<char*>(data), size);
+    }
+
+    MappedInput(const MappedInput&) = delete;
+    MappedInput& operator=(const MappedInput&) = delete;
+
+    bool isOpen() {
+        return rdbuf() != nullptr;
+    }
+
+private:
+    const char* data;
+    std::size_t size;
+    MemoryBuffer memory;
+};
+
+#endif //DATA_ENCODING_P01_MAPPEDINPUT_HPP
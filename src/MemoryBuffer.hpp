@@ -0,0 +1,105 @@
+#ifndef DATA_ENCODING_P01_MEMORYBUFFER_HPP
+#define DATA_ENCODING_P01_MEMORYBUFFER_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <streambuf>
+#include <vector>
+
+/*
+ * A stream buffer over bytes already in memory, which can be seeked. Besides being read through an istream, the coders
+ * can take whole spans of the memory with take, so that blocks are coded where they lie rather than being copied out.
+ */
+class MemoryBuffer : public std::streambuf {
+public:
+    //the memory must outlive the buffer
+    MemoryBuffer(const char* data, std::size_t size) {
+        assign(data, size);
+    }
+
+    //read from other memory instead, starting at its beginning
+    void assign(const char* data, std::size_t size) {
+        char* begin = const_cast<char*>(data);
+        setg(begin, begin, begin + size);
+    }
+
+    //return the number of bytes left to read
+    std::size_t available() const {
+        return static_cast<std::size_t>(egptr() - gptr());
+    }
+
+    //move past the next n bytes (or as many as are left), returning where they start
+    const char* take(std::size_t n) {
+        char* start = gptr();
+        setg(eback(), start + std::min(n, available()), egptr());
+        return start;
+    }
+
+protected:
+    virtual pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override {
+        char* base = dir == std::ios_base::beg ? eback() : dir == std::ios_base::cur ? gptr() : egptr();
+        return seekTo(base + off - eback(), which);
+    }
+
+    virtual pos_type seekpos(pos_type pos, std::ios_base::openmode which) override {
+        return seekTo(static_cast<off_type>(pos), which);
+    }
+
+private:
+    pos_type seekTo(off_type pos, std::ios_base::openmode which) {
+        if (!(which & std::ios_base::in) || pos < 0 || pos > egptr() - eback())
+            return pos_type(off_type(-1));
+        setg(eback(), eback() + pos, egptr());
+        return pos_type(pos);
+    }
+};
+
+/*
+ * A stream buffer writing into a fixed span of memory. Writing past the end of the span fails, leaving the stream bad,
+ * rather than allocating more.
+ */
+class FixedOutputBuffer : public std::streambuf {
+public:
+    FixedOutputBuffer() {}
+
+    //the memory must outlive the buffer
+    FixedOutputBuffer(char* data, std::size_t size) {
+        assign(data, size);
+    }
+
+    //write into other memory instead, starting at its beginning
+    void assign(char* data, std::size_t size) {
+        setp(data, data + size);
+    }
+
+    //return the number of bytes written so far
+    std::size_t written() const {
+        return static_cast<std::size_t>(pptr() - pbase());
+    }
+};
+
+/*
+ * A stream buffer appending everything written to it to the end of a vector.
+ */
+class VectorOutputBuffer : public std::streambuf {
+public:
+    //the vector must outlive the buffer
+    VectorOutputBuffer(std::vector<char>& bytes) : bytes(bytes) {}
+
+protected:
+    virtual std::streamsize xsputn(const char* data, std::streamsize size) override {
+        bytes.insert(bytes.end(), data, data + size);
+        return size;
+    }
+
+    virtual int_type overflow(int_type c) override {
+        if (!traits_type::eq_int_type(c, traits_type::eof()))
+            bytes.push_back(traits_type::to_char_type(c));
+        return traits_type::not_eof(c);
+    }
+
+private:
+    std::vector<char>& bytes;
+};
+
+#endif //DATA_ENCODING_P01_MEMORYBUFFER_HPP
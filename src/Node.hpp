@@ -5,6 +5,7 @@
 #include <sstream>
 #include <functional>
 #include <queue>
+#include <vector>
 
 /*
  * Defines a tree node with elements of type T, and with N maximum children.
@@ -32,10 +33,24 @@ public:
     Node() : Node(T()) {}
 
     ~Node() {
-        if (N > 0) {
-            // destruct all children, leaf-first, recursively
-            for (auto child : children)
-                delete child;
+        if (isLeaf())
+            return;
+        // destruct all descendants without recursing, so that a deep tree cannot overflow the stack. each node's children
+        // are taken from it before it is deleted, leaving its own destructor nothing to do
+        std::vector<Node<T, N>*> pending;
+        for (auto child : children) {
+            if (child != nullptr)
+                pending.push_back(child);
+        }
+        while (!pending.empty()) {
+            Node<T, N>* node = pending.back();
+            pending.pop_back();
+            for (auto child : node->children) {
+                if (child != nullptr)
+                    pending.push_back(child);
+            }
+            node->clearChildren();
+            delete node;
         }
     }
 
@@ -61,6 +76,11 @@ public:
         }
     }
 
+    //forget all of the children without destructing them, for when they are owned by something else
+    void clearChildren() {
+        children.fill(nullptr);
+    }
+
     //Get the ith child in this node's child list.
     Node<T, N>* child(int i) {
         return children[i];
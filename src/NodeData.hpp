@@ -8,12 +8,17 @@ struct NodeData {
 public:
     int weight;
     Optional<T> value;
+    //the node's number in the sibling ordering, this belongs to the node's position in the tree and is never swapped
+    unsigned long index;
 
-    NodeData(int weight, Optional<T> value) {
+    NodeData(int weight, Optional<T> value, unsigned long index) {
         this->weight = weight;
         this->value = value;
+        this->index = index;
     }
 
+    NodeData(int weight, Optional<T> value) : NodeData(weight, value, 0) {}
+
     NodeData() : NodeData(0, Optional<T>()) {}
 
     void increment() {
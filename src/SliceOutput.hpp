@@ -0,0 +1,126 @@
+#ifndef DATA_ENCODING_P01_SLICEOUTPUT_HPP
+#define DATA_ENCODING_P01_SLICEOUTPUT_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/*
+ * An output of known length which can be written in any order, a slice at a time. Slices which do not overlap may be
+ * written from different threads at once.
+ */
+class SliceOutput {
+public:
+    virtual ~SliceOutput() {}
+
+    //make room for the whole output, to be called before any slice is written
+    virtual bool allocate(std::uint64_t length) = 0;
+
+    //write size bytes of data to the output, starting at the offset
+    virtual bool write(std::uint64_t offset, const char* data, std::size_t size) = 0;
+
+    //return the size bytes of the output starting at the offset as memory to be written straight into, or null if the
+    //output is not in memory (in which case write must be used)
+    virtual char* map(std::uint64_t /*offset*/, std::size_t /*size*/) {
+        return nullptr;
+    }
+};
+
+/*
+ * A file written with pwrite, which is given its full length up front.
+ */
+class FileSliceOutput : public SliceOutput {
+public:
+    //open (creating or emptying) the file, check isOpen to see if this succeeded
+    FileSliceOutput(const std::string& path) {
+        //opened for reading too, so that the file can be mapped
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0666);
+    }
+
+    ~FileSliceOutput() {
+        if (isOpen())
+            ::close(fd);
+    }
+
+    FileSliceOutput(const FileSliceOutput&) = delete;
+    FileSliceOutput& operator=(const FileSliceOutput&) = delete;
+
+    bool isOpen() {
+        return fd >= 0;
+    }
+
+    virtual bool allocate(std::uint64_t length) override {
+        return isOpen() && ::ftruncate(fd, static_cast<off_t>(length)) == 0;
+    }
+
+    virtual bool write(std::uint64_t offset, const char* data, std::size_t size) override {
+        //pwrite may write less than asked for, in which case it carries on from where it stopped
+        while (size > 0) {
+            ssize_t written = ::pwrite(fd, data, size, static_cast<off_t>(offset));
+            if (written <= 0)
+                return false;
+            data += written;
+            offset += written;
+            size -= written;
+        }
+        return true;
+    }
+
+protected:
+    int fd;
+};
+
+/*
+ * A file mapped into memory once it has been given its length, so that slices can be decoded straight into it. If the
+ * file cannot be mapped it is written with pwrite instead.
+ */
+class MappedSliceOutput : public FileSliceOutput {
+public:
+    MappedSliceOutput(const std::string& path) : FileSliceOutput(path), data(nullptr), length(0) {}
+
+    ~MappedSliceOutput() {
+        if (data != nullptr)
+            ::munmap(data, length);
+    }
+
+    virtual bool allocate(std::uint64_t length) override {
+        if (!FileSliceOutput::allocate(length))
+            return false;
+        //an empty file cannot be mapped, and a failed mapping falls back on pwrite
+        void* mapped = length == 0 ? MAP_FAILED : ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (mapped != MAP_FAILED)
+            data = static_cast<char*>(mapped);
+        this->length = static_cast<std::size_t>(length);
+        return true;
+    }
+
+    //slices past the length given to allocate are refused
+    virtual bool write(std::uint64_t offset, const char* data, std::size_t size) override {
+        if (!fits(offset, size))
+            return false;
+        if (this->data == nullptr)
+            return FileSliceOutput::write(offset, data, size);
+        std::memcpy(this->data + offset, data, size);
+        return true;
+    }
+
+    virtual char* map(std::uint64_t offset, std::size_t size) override {
+        return data == nullptr || !fits(offset, size) ? nullptr : data + offset;
+    }
+
+private:
+    //the mapping, if the file is mapped, and the length given to allocate
+    char* data;
+    std::size_t length;
+
+    //return true if the slice lies within the output
+    bool fits(std::uint64_t offset, std::size_t size) {
+        return offset <= length && size <= length - offset;
+    }
+};
+
+#endif //DATA_ENCODING_P01_SLICEOUTPUT_HPP
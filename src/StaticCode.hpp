@@ -0,0 +1,312 @@
+#ifndef DATA_ENCODING_P01_STATICCODE_HPP
+#define DATA_ENCODING_P01_STATICCODE_HPP
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <vector>
+#include "BitWriter.hpp"
+#include "BitReader.hpp"
+#include "Stats.hpp"
+
+/*
+ * A static (two-pass) canonical Huffman code, built afresh for each block. The first pass counts the block's symbols,
+ * the second codes them with a fixed table, so unlike the adaptive trees there is no work per symbol beyond a lookup.
+ *
+ * The code lengths are limited to MAX_LENGTH bits, and the code is canonical: the codes of each length are consecutive
+ * numbers in symbol order, following on from the codes one bit shorter. This means the lengths alone describe the
+ * code, and they are sent at the start of the block's code as runs of equal lengths, each run being the length in
+ * LENGTH_BITS bits followed by the number of symbols in the run as an Elias gamma code. Unused symbols have length zero,
+ * so a block using few symbols needs only a few runs.
+ *
+ * Codes of up to TABLE_BITS bits are decoded with one lookup in a table indexed by the next TABLE_BITS bits of input.
+ * Longer codes, which can only occur with symbols wider than a byte, are found by trying each longer length in turn.
+ */
+template<typename T> class StaticCode {
+public:
+    static const unsigned long ALPHABET_SIZE = 1UL << (sizeof(T) * CHAR_BIT);
+    //the longest code, a few bits more than a symbol so that rare symbols can make way for common ones
+    static const unsigned MAX_LENGTH = sizeof(T) * CHAR_BIT + 4;
+    static const unsigned LENGTH_BITS = 5;
+    static const unsigned TABLE_BITS = 12;
+
+    //code n symbols, appending the code lengths and then the code to the end of the vector. the code is padded with
+    //zeroes to a whole byte
+    void encodeBlock(const T* symbols, std::size_t n, std::vector<char>& code) {
+        HUFF_COUNT(SYMBOLS, n);
+        HUFF_TIME(BIT_TIME);
+        allocate();
+        countSymbols(symbols, n);
+        buildLengths();
+        assignCodes();
+        BitWriter<T> bits(code);
+        writeLengths(bits);
+        for (std::size_t i = 0; i < n; i++)
+            bits.writeBits(codes[symbols[i]], lengths[symbols[i]]);
+        bits.flush();
+    }
+
+    //decode n symbols from size bytes of code into the symbols array, returns false if the code is not valid
+    bool decodeBlock(const char* code, std::size_t size, T* symbols, std::size_t n) {
+        HUFF_COUNT(SYMBOLS, n);
+        HUFF_TIME(BIT_TIME);
+        allocate();
+        BitReader<T> reader(code, size);
+        if (!readLengths(reader) || !buildTable())
+            return false;
+        for (std::size_t i = 0; i < n; i++) {
+            const Entry& entry = table[reader.peekBits(TABLE_BITS)];
+            if (entry.length != 0) {
+                reader.consumeBits(entry.length);
+                symbols[i] = entry.symbol;
+            } else if (!decodeLong(reader, symbols[i]))
+                return false;
+        }
+        //the code must not run past the end of the block
+        return reader.getBitsRead() <= size * CHAR_BIT;
+    }
+
+private:
+    struct Entry {
+        T symbol;
+        //the length of the code, zero if the code is longer than TABLE_BITS bits (or not valid)
+        unsigned char length;
+    };
+
+    //the number of times each symbol appears, its code length and its code
+    std::vector<std::uint32_t> counts;
+    std::vector<unsigned char> lengths;
+    std::vector<std::uint32_t> codes;
+    //the used symbols, in order of their codes, the number of codes of each length and the first code of each length
+    std::vector<T> sorted;
+    std::uint32_t lengthCounts[MAX_LENGTH + 1];
+    std::uint32_t firstCodes[MAX_LENGTH + 1];
+    //the position in sorted of the first symbol with a code of each length
+    std::uint32_t firstSymbols[MAX_LENGTH + 1];
+    std::vector<Entry> table;
+    //the used symbols, and the weight, parent and depth of each node of the tree built from them, with the number of
+    //leaves at each depth. these are only needed while building the lengths, but are kept so as to be allocated once
+    std::vector<T> used;
+    std::vector<std::uint64_t> weights;
+    std::vector<std::size_t> parents;
+    std::vector<unsigned> depths;
+    std::vector<std::uint32_t> depthCounts;
+
+    //the tables are only made once a block is coded, so that a coder which never codes statically costs nothing
+    void allocate() {
+        if (!counts.empty())
+            return;
+        counts.resize(ALPHABET_SIZE);
+        lengths.resize(ALPHABET_SIZE);
+        codes.resize(ALPHABET_SIZE);
+        sorted.resize(ALPHABET_SIZE);
+        table.resize(1UL << TABLE_BITS);
+    }
+
+    //the first pass, counting each symbol. bytes are counted into four tables in turn, so that runs of one symbol do not
+    //wait on each increment before the next
+    void countSymbols(const T* symbols, std::size_t n) {
+        std::fill(counts.begin(), counts.end(), 0);
+        std::size_t i = 0;
+        if (sizeof(T) == 1) {
+            std::uint32_t ways[4][256] = {};
+            for (; i + 4 <= n; i += 4) {
+                ways[0][symbols[i]]++;
+                ways[1][symbols[i + 1]]++;
+                ways[2][symbols[i + 2]]++;
+                ways[3][symbols[i + 3]]++;
+            }
+            for (unsigned long s = 0; s < 256; s++)
+                counts[s] = ways[0][s] + ways[1][s] + ways[2][s] + ways[3][s];
+        }
+        for (; i < n; i++)
+            counts[symbols[i]]++;
+    }
+
+    //work out the length of each symbol's code: the Huffman code lengths, with any longer than MAX_LENGTH cut down
+    void buildLengths() {
+        std::fill(lengths.begin(), lengths.end(), 0);
+        //the used symbols, least common first
+        used.clear();
+        for (unsigned long s = 0; s < ALPHABET_SIZE; s++) {
+            if (counts[s] != 0)
+                used.push_back(static_cast<T>(s));
+        }
+        if (used.empty())
+            return;
+        if (used.size() == 1) {
+            lengths[used[0]] = 1;
+            return;
+        }
+        //ties are broken by symbol, the order the symbols were found in, as stable_sort would but without its buffer
+        std::sort(used.begin(), used.end(), [this](T a, T b) { return counts[a] < counts[b] || (counts[a] == counts[b] && a < b); });
+        //build the tree by merging the two lightest nodes. both the leaves and the merged nodes come out in order of
+        //weight, so the lightest node is always at the front of one of the two queues. merged node i is node m + i
+        std::size_t m = used.size();
+        weights.resize(2 * m - 1);
+        parents.resize(2 * m - 1);
+        for (std::size_t i = 0; i < m; i++)
+            weights[i] = counts[used[i]];
+        std::size_t leaf = 0, merged = m;
+        for (std::size_t next = m; next < 2 * m - 1; next++) {
+            std::size_t pair[2];
+            for (std::size_t& node : pair)
+                node = leaf < m && (merged == next || weights[leaf] <= weights[merged]) ? leaf++ : merged++;
+            weights[next] = weights[pair[0]] + weights[pair[1]];
+            parents[pair[0]] = parents[pair[1]] = next;
+        }
+        //the depth of each node follows from its parent's, the root being the last node made
+        depths.assign(2 * m - 1, 0);
+        depthCounts.assign(1, 0);
+        for (std::size_t i = 2 * m - 1; i-- > 0;) {
+            if (i != 2 * m - 2)
+                depths[i] = depths[parents[i]] + 1;
+            if (i < m) {
+                if (depthCounts.size() <= depths[i])
+                    depthCounts.resize(depths[i] + 1, 0);
+                depthCounts[depths[i]]++;
+            }
+        }
+        limitLengths(depthCounts);
+        //the shortest codes go to the most common symbols
+        std::size_t i = m;
+        for (unsigned length = 1; length <= MAX_LENGTH; length++) {
+            for (std::uint32_t k = 0; k < lengthCounts[length]; k++)
+                lengths[used[--i]] = static_cast<unsigned char>(length);
+        }
+    }
+
+    //fill lengthCounts from the number of leaves at each depth, cutting every code longer than MAX_LENGTH down to it.
+    //this leaves too many short codes to fit, so codes are then moved one bit longer, the longest which are still
+    //shorter than MAX_LENGTH first, until they fit again
+    void limitLengths(const std::vector<std::uint32_t>& depthCounts) {
+        std::fill(lengthCounts, lengthCounts + MAX_LENGTH + 1, 0);
+        for (std::size_t depth = 1; depth < depthCounts.size(); depth++)
+            lengthCounts[std::min<std::size_t>(depth, MAX_LENGTH)] += depthCounts[depth];
+        //the Kraft sum, in units of the space taken by a code of MAX_LENGTH bits
+        std::uint64_t space = 0;
+        for (unsigned length = 1; length <= MAX_LENGTH; length++)
+            space += std::uint64_t(lengthCounts[length]) << (MAX_LENGTH - length);
+        while (space > (std::uint64_t(1) << MAX_LENGTH)) {
+            unsigned length = MAX_LENGTH - 1;
+            while (lengthCounts[length] == 0)
+                length--;
+            lengthCounts[length]--;
+            lengthCounts[length + 1]++;
+            space -= std::uint64_t(1) << (MAX_LENGTH - length - 1);
+        }
+    }
+
+    //give each symbol its canonical code from its length
+    void assignCodes() {
+        std::fill(lengthCounts, lengthCounts + MAX_LENGTH + 1, 0);
+        for (unsigned long s = 0; s < ALPHABET_SIZE; s++)
+            lengthCounts[lengths[s]]++;
+        std::uint32_t next[MAX_LENGTH + 1];
+        std::uint32_t code = 0;
+        lengthCounts[0] = 0;
+        for (unsigned length = 1; length <= MAX_LENGTH; length++) {
+            code = (code + lengthCounts[length - 1]) << 1;
+            next[length] = code;
+        }
+        for (unsigned long s = 0; s < ALPHABET_SIZE; s++) {
+            if (lengths[s] != 0)
+                codes[s] = next[lengths[s]]++;
+            HUFF_MAX(DEPTH, lengths[s]);
+        }
+    }
+
+    //write the code lengths as runs of equal lengths
+    void writeLengths(BitWriter<T>& bits) {
+        for (unsigned long s = 0; s < ALPHABET_SIZE;) {
+            unsigned long run = 1;
+            while (s + run < ALPHABET_SIZE && lengths[s + run] == lengths[s])
+                run++;
+            bits.writeBits(lengths[s], LENGTH_BITS);
+            //the Elias gamma code: one less than the number of bits in the run, as zeroes, then the run itself
+            unsigned width = 0;
+            while ((run >> width) > 1)
+                width++;
+            bits.writeBits(0, width);
+            bits.writeBits(run, width + 1);
+            s += run;
+        }
+    }
+
+    //read the code lengths written by writeLengths, returns false if they are not valid
+    bool readLengths(BitReader<T>& reader) {
+        for (unsigned long s = 0; s < ALPHABET_SIZE;) {
+            unsigned length = static_cast<unsigned>(reader.readBits(LENGTH_BITS));
+            unsigned width = 0;
+            while (width <= sizeof(T) * CHAR_BIT && reader.read() == 0)
+                width++;
+            if (length > MAX_LENGTH || width > sizeof(T) * CHAR_BIT)
+                return false;
+            //the leading one of the run was read while counting the zeroes
+            unsigned long run = (1UL << width) | static_cast<unsigned long>(reader.readBits(width));
+            if (run > ALPHABET_SIZE - s)
+                return false;
+            std::fill(lengths.begin() + s, lengths.begin() + s + run, static_cast<unsigned char>(length));
+            s += run;
+        }
+        return true;
+    }
+
+    //work out the canonical codes from the lengths and fill the lookup table, returns false if the lengths are too short
+    //to all have codes
+    bool buildTable() {
+        std::fill(lengthCounts, lengthCounts + MAX_LENGTH + 1, 0);
+        for (unsigned long s = 0; s < ALPHABET_SIZE; s++)
+            lengthCounts[lengths[s]]++;
+        lengthCounts[0] = 0;
+        std::uint64_t space = 0;
+        std::uint32_t code = 0, position = 0;
+        for (unsigned length = 1; length <= MAX_LENGTH; length++) {
+            space += std::uint64_t(lengthCounts[length]) << (MAX_LENGTH - length);
+            code = (code + lengthCounts[length - 1]) << 1;
+            firstCodes[length] = code;
+            firstSymbols[length] = position;
+            position += lengthCounts[length];
+        }
+        if (space > (std::uint64_t(1) << MAX_LENGTH))
+            return false;
+        std::uint32_t next[MAX_LENGTH + 1];
+        std::copy(firstSymbols, firstSymbols + MAX_LENGTH + 1, next);
+        for (unsigned long s = 0; s < ALPHABET_SIZE; s++) {
+            if (lengths[s] != 0)
+                sorted[next[lengths[s]]++] = static_cast<T>(s);
+        }
+        //every entry starting with a code of up to TABLE_BITS bits leads to its symbol, the rest are left empty
+        std::fill(table.begin(), table.end(), Entry());
+        for (unsigned length = 1; length <= TABLE_BITS && length <= MAX_LENGTH; length++) {
+            for (std::uint32_t k = 0; k < lengthCounts[length]; k++) {
+                Entry entry;
+                entry.symbol = sorted[firstSymbols[length] + k];
+                entry.length = static_cast<unsigned char>(length);
+                unsigned shift = TABLE_BITS - length;
+                std::uint32_t start = (firstCodes[length] + k) << shift;
+                std::fill(table.begin() + start, table.begin() + start + (1UL << shift), entry);
+            }
+        }
+        return true;
+    }
+
+    //decode a symbol with a code longer than TABLE_BITS bits, returns false if there is no such code
+    bool decodeLong(BitReader<T>& reader, T& symbol) {
+        for (unsigned length = TABLE_BITS + 1; length <= MAX_LENGTH; length++) {
+            std::uint32_t code = static_cast<std::uint32_t>(reader.peekBits(length));
+            if (code - firstCodes[length] < lengthCounts[length]) {
+                reader.consumeBits(length);
+                symbol = sorted[firstSymbols[length] + code - firstCodes[length]];
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+template<typename T> const unsigned long StaticCode<T>::ALPHABET_SIZE;
+template<typename T> const unsigned StaticCode<T>::MAX_LENGTH;
+template<typename T> const unsigned StaticCode<T>::TABLE_BITS;
+
+#endif //DATA_ENCODING_P01_STATICCODE_HPP
@@ -0,0 +1,148 @@
+#ifndef DATA_ENCODING_P01_STATS_HPP
+#define DATA_ENCODING_P01_STATS_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+
+/*
+ * Counters and timers for the hot paths of coding, for seeing where the time goes on a given input without a profiler.
+ * They are only compiled in when HUFF_STATS is defined (the CMake option of the same name): otherwise HUFF_COUNT,
+ * HUFF_MAX and HUFF_TIME record nothing, so a normal build pays nothing for them.
+ *
+ * Each thread counts into its own counters, which are added to the totals when the thread ends (or when collect is
+ * called on it), so workers coding blocks in parallel do not contend over the counters. Timers are the wall time spent
+ * in each part on each thread, so with several threads they add up to more than the time the whole run took. Reading
+ * the clock around every symbol slows coding down a good deal, so the times are best read as proportions.
+ */
+class Stats {
+public:
+    enum Counter {
+        //symbols coded, symbols sent as NYT escapes (their first appearance), swaps and slides made to update the trees,
+        //bits of code, and the longest code (the depth of the deepest leaf reached)
+        SYMBOLS, ESCAPES, SWAPS, CODE_BITS, DEPTH,
+        //nanoseconds spent updating trees, reading and writing bits of code, and reading and writing the streams
+        UPDATE_TIME, BIT_TIME, STREAM_TIME,
+        COUNTERS
+    };
+
+    //add n to a counter
+    static void add(Counter counter, std::uint64_t n) {
+        local().values[counter] += n;
+    }
+
+    //raise a counter to n if it is lower
+    static void max(Counter counter, std::uint64_t n) {
+        std::uint64_t& value = local().values[counter];
+        value = std::max(value, n);
+    }
+
+    //add the calling thread's counters to the totals, as is done when a thread ends
+    static void collect() {
+        local().merge();
+    }
+
+    //return a counter's total, counting threads which have ended or been collected
+    static std::uint64_t get(Counter counter) {
+        return totals()[counter].load();
+    }
+
+    //write the totals as a table, or as a JSON object
+    static void report(std::ostream& output, bool json) {
+        collect();
+        std::uint64_t symbols = get(SYMBOLS);
+        double codeLength = symbols == 0 ? 0 : static_cast<double>(get(CODE_BITS)) / symbols;
+        double seconds[3] = {get(UPDATE_TIME) * 1e-9, get(BIT_TIME) * 1e-9, get(STREAM_TIME) * 1e-9};
+        double total = seconds[0] + seconds[1] + seconds[2];
+        const char* parts[3] = {"tree_update", "bit_io", "stream_io"};
+        if (json) {
+            output << "{\"symbols\": " << symbols << ", \"nyt_escapes\": " << get(ESCAPES) << ", \"swaps\": "
+                   << get(SWAPS) << ", \"average_code_length\": " << codeLength << ", \"tree_depth\": " << get(DEPTH)
+                   << ", \"seconds\": {";
+            for (int i = 0; i < 3; i++)
+                output << (i == 0 ? "" : ", ") << "\"" << parts[i] << "\": " << seconds[i];
+            output << "}}" << std::endl;
+            return;
+        }
+        output << "symbols coded      : " << symbols << "\n";
+        output << "NYT escapes        : " << get(ESCAPES) << "\n";
+        output << "swaps              : " << get(SWAPS) << "\n";
+        output << "average code length: " << codeLength << " bits\n";
+        output << "tree depth         : " << get(DEPTH) << "\n";
+        const char* names[3] = {"tree update", "bit I/O    ", "stream I/O "};
+        for (int i = 0; i < 3; i++) {
+            output << "time in " << names[i] << ": " << std::fixed << std::setprecision(3) << seconds[i] << "s ("
+                   << std::setprecision(1) << (total > 0 ? 100 * seconds[i] / total : 0) << "%)\n";
+        }
+        output.unsetf(std::ios::fixed);
+    }
+
+    //adds the time from its making until it is destroyed to a timer
+    class Timer {
+    public:
+        Timer(Counter counter) : counter(counter), start(std::chrono::steady_clock::now()) {}
+
+        ~Timer() {
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            add(counter, static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+        }
+
+    private:
+        Counter counter;
+        std::chrono::steady_clock::time_point start;
+    };
+
+private:
+    //the counters of one thread
+    struct Local {
+        std::uint64_t values[COUNTERS] = {};
+
+        ~Local() {
+            merge();
+        }
+
+        //move the counters into the totals
+        void merge() {
+            for (int i = 0; i < COUNTERS; i++) {
+                std::atomic<std::uint64_t>& total = totals()[i];
+                if (i == DEPTH) {
+                    std::uint64_t current = total.load();
+                    while (current < values[i] && !total.compare_exchange_weak(current, values[i])) {}
+                } else
+                    total += values[i];
+                values[i] = 0;
+            }
+        }
+    };
+
+    static Local& local() {
+        static thread_local Local counters;
+        return counters;
+    }
+
+    static std::atomic<std::uint64_t>* totals() {
+        static std::atomic<std::uint64_t> values[COUNTERS];
+        return values;
+    }
+};
+
+#ifdef HUFF_STATS
+#define HUFF_STATS_JOIN(a, b) a##b
+#define HUFF_STATS_NAME(line) HUFF_STATS_JOIN(huffStatsTimer, line)
+//add n to the counter
+#define HUFF_COUNT(counter, n) Stats::add(Stats::counter, n)
+//raise the counter to n if it is lower
+#define HUFF_MAX(counter, n) Stats::max(Stats::counter, n)
+//add the time until the end of the enclosing scope to the timer
+#define HUFF_TIME(counter) Stats::Timer HUFF_STATS_NAME(__LINE__)(Stats::counter)
+#else
+//the value is still worked out, so that variables kept only for it are not left unused
+#define HUFF_COUNT(counter, n) static_cast<void>(n)
+#define HUFF_MAX(counter, n) static_cast<void>(n)
+#define HUFF_TIME(counter)
+#endif
+
+#endif //DATA_ENCODING_P01_STATS_HPP
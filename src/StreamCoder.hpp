@@ -0,0 +1,328 @@
+#ifndef DATA_ENCODING_P01_STREAMCODER_HPP
+#define DATA_ENCODING_P01_STREAMCODER_HPP
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "HuffmanEncoder.hpp"
+#include "HuffmanDecoder.hpp"
+#include "MemoryBuffer.hpp"
+
+/*
+ * Push-style coders for long-lived streams, such as a connection carrying many messages. Rather than reading an input
+ * stream to its end, symbols are fed in as they arrive and the code drained out as it is ready (or the other way round
+ * to decode). The stream is a container (see Container.hpp) written a block at a time: flush ends the block being coded
+ * early, which is a sync point where the decoder can give back everything fed in so far without the stream ending. The
+ * code tree carries on across blocks, so compression keeps improving for as long as the stream lasts.
+ *
+ * Besides the block being coded, the encoder only holds the stream's index, a few bytes per block, which is written at
+ * the end. A stream flushed often, such as after every message on a connection, should have the UNINDEXED flag in its
+ * header, so that it has no index and the encoder's memory does not grow with the number of blocks. The decoder never
+ * holds the index, only its checksum.
+ */
+template<typename T> class StreamEncoder {
+public:
+    //start a stream described by the header, coded with the tree. the header is ready to be drained straight away
+    StreamEncoder(HuffmanTree<T>& tree, const ContainerHeader& header)
+            : tree(tree), header(header), readyBuffer(ready), readyStream(&readyBuffer), bits(code), used(0), n(0),
+              dataCrc(0), count(0), offset(header.size()), length(0), finished(false) {
+        tree.cacheCodes(true);
+        tree.setRescaleThreshold(static_cast<int>(header.getRescaleThreshold()));
+        header.write(readyStream);
+    }
+
+    ~StreamEncoder() {
+        tree.cacheCodes(false);
+    }
+
+    StreamEncoder(const StreamEncoder&) = delete;
+    StreamEncoder& operator=(const StreamEncoder&) = delete;
+
+    //code size more symbols, returns false if the stream has already been finished
+    bool feed(const T* symbols, std::size_t size) {
+        if (finished)
+            return false;
+        //the symbols are added to the block's checksum a run at a time, each run ending at the end of a block or the feed
+        std::size_t from = 0;
+        for (std::size_t i = 0; i < size; i++) {
+            if (n == 0 && header.isIndependent())
+                tree.reset();
+            HuffmanEncoder<T>::encodeSymbol(tree, symbols[i], bits);
+            if (++n == header.blockSize) {
+                addToChecksum(symbols + from, i + 1 - from);
+                from = i + 1;
+                endBlock();
+            }
+        }
+        addToChecksum(symbols + from, size - from);
+        return true;
+    }
+
+    //end the block being coded, so that everything fed in so far can be decoded once drained
+    void flush() {
+        if (n > 0)
+            endBlock();
+    }
+
+    //flush, then end the stream with the index and footer. nothing more can be fed in afterwards
+    void finish() {
+        if (finished)
+            return;
+        flush();
+        BlockHeader().write(readyStream);
+        std::uint32_t indexCrc = BlockIndexEntry::writeIndex(readyStream, index);
+        ContainerFooter(length, count, indexCrc).write(readyStream);
+        finished = true;
+    }
+
+    //return the number of bytes of code ready to be drained
+    std::size_t available() const {
+        return ready.size() - used;
+    }
+
+    //move up to capacity bytes of ready code into the output, returns the number moved
+    std::size_t drain(char* output, std::size_t capacity) {
+        std::size_t size = std::min(capacity, available());
+        std::memcpy(output, ready.data() + used, size);
+        used += size;
+        if (used == ready.size()) {
+            ready.clear();
+            used = 0;
+        }
+        return size;
+    }
+
+private:
+    HuffmanTree<T>& tree;
+    ContainerHeader header;
+    //code which is ready to be drained, from used onwards
+    std::vector<char> ready;
+    VectorOutputBuffer readyBuffer;
+    std::ostream readyStream;
+    //the code of the block being coded, which holds n symbols
+    std::vector<char> code;
+    BitWriter<T> bits;
+    std::size_t used;
+    std::uint32_t n;
+    //the checksum of the block's symbols
+    std::uint32_t dataCrc;
+    //the index of the blocks made so far (empty without one), the number of them, the offset of the next one, and the
+    //number of bytes of input in them
+    std::vector<BlockIndexEntry> index;
+    std::uint32_t count;
+    std::uint64_t offset, length;
+    bool finished;
+
+    void addToChecksum(const T* symbols, std::size_t size) {
+        dataCrc = Crc32::update(dataCrc, reinterpret_cast<const char*>(symbols), size * sizeof(T));
+    }
+
+    void endBlock() {
+        bits.flush();
+        std::uint32_t bytes = static_cast<std::uint32_t>(n * sizeof(T));
+        BlockHeader::make(bytes, dataCrc, code.data(), static_cast<std::uint32_t>(code.size())).write(readyStream);
+        readyStream.write(code.data(), code.size());
+        if (header.isIndexed())
+            index.push_back(BlockIndexEntry(offset, bytes));
+        count++;
+        offset += BlockHeader::SIZE + code.size();
+        length += bytes;
+        code.clear();
+        n = 0;
+        dataCrc = 0;
+    }
+};
+
+/*
+ * Decodes a stream written by StreamEncoder (or any container) fed in a piece at a time. Each block is decoded once
+ * the whole of it has been fed in, so the decoder holds at most one block of code.
+ */
+template<typename T> class StreamDecoder {
+public:
+    //creates the code tree for the algorithm in the stream's header
+    typedef std::function<HuffmanTree<T>*(const ContainerHeader&)> TreeFactory;
+
+    StreamDecoder(TreeFactory makeTree) : makeTree(makeTree), staticBlocks(false), state(HEADER), used(0), decodedUsed(0),
+                                          indexCrc(0), count(0), offset(ContainerHeader::SIZE), length(0) {}
+
+    StreamDecoder(const StreamDecoder&) = delete;
+    StreamDecoder& operator=(const StreamDecoder&) = delete;
+
+    //decode as much as possible with size more bytes of the stream. returns false, with the reason given by getError, if
+    //the stream is not valid
+    bool feed(const char* data, std::size_t size) {
+        if (state == FAILED)
+            return false;
+        if (state == DONE && size > 0)
+            return fail("more input after the end of the stream");
+        //the bytes already decoded are dropped first, so that at most one block is kept
+        pending.erase(pending.begin(), pending.begin() + used);
+        used = 0;
+        pending.insert(pending.end(), data, data + size);
+        while (step()) {}
+        if (state == DONE && used < pending.size())
+            return fail("more input after the end of the stream");
+        return state != FAILED;
+    }
+
+    //return true once the whole stream, up to and including its footer, has been decoded
+    bool isFinished() const {
+        return state == DONE;
+    }
+
+    //return the number of decoded symbols ready to be drained
+    std::size_t available() const {
+        return decoded.size() - decodedUsed;
+    }
+
+    //move up to capacity decoded symbols into the output, returns the number moved
+    std::size_t drain(T* output, std::size_t capacity) {
+        std::size_t size = std::min(capacity, available());
+        std::copy(decoded.begin() + decodedUsed, decoded.begin() + decodedUsed + size, output);
+        decodedUsed += size;
+        if (decodedUsed == decoded.size()) {
+            decoded.clear();
+            decodedUsed = 0;
+        }
+        return size;
+    }
+
+    //return the reason that the stream is not valid
+    const std::string& getError() const {
+        return error;
+    }
+
+private:
+    enum State {
+        HEADER, BLOCKS, TRAILER, DONE, FAILED
+    };
+
+    TreeFactory makeTree;
+    //the table is destroyed before the tree it follows
+    std::unique_ptr<HuffmanTree<T>> tree;
+    std::unique_ptr<DecodeTable<T>> table;
+    //the code for the blocks of a stream using the STATIC algorithm, which is used in place of the tree
+    StaticCode<T> staticCode;
+    bool staticBlocks;
+    State state;
+    ContainerHeader header;
+    //bytes fed in but not yet decoded, from used onwards
+    std::vector<char> pending;
+    std::size_t used;
+    //symbols decoded but not yet drained, from decodedUsed onwards
+    std::vector<T> decoded;
+    std::size_t decodedUsed;
+    //the checksum of the index of the blocks decoded so far, the number of them, the offset of the next one, and the number
+    //of bytes of input in them
+    std::uint32_t indexCrc;
+    std::uint32_t count;
+    std::uint64_t offset, length;
+    std::string error;
+
+    bool fail(const std::string& reason) {
+        error = reason;
+        state = FAILED;
+        return false;
+    }
+
+    //decode the next part of the stream if all of it has been fed in, returns true if there may be more to decode
+    bool step() {
+        std::size_t size = pending.size() - used;
+        MemoryBuffer view(pending.data() + used, size);
+        std::istream input(&view);
+        switch (state) {
+            case HEADER: {
+                //the flags, just before the symbol size, say whether the header holds a rescale threshold
+                if (size < ContainerHeader::SIZE || size < ContainerHeader::sizeFor(static_cast<unsigned char>(pending[used + 6])))
+                    return false;
+                if (!header.read(input))
+                    return fail("not a huff stream");
+                if (header.version != ContainerHeader::VERSION)
+                    return fail("unsupported version " + std::to_string(header.version));
+                if (!header.check())
+                    return fail("corrupt header (checksum mismatch)");
+                if (header.symbolBits != sizeof(T) * CHAR_BIT)
+                    return fail("unsupported symbol size of " + std::to_string(header.symbolBits) + " bits");
+                if (!header.checkRescaleThreshold())
+                    return fail("unsupported rescale threshold of " + std::to_string(header.rescaleThreshold));
+                tree.reset(makeTree(header));
+                if (!tree)
+                    return fail("unknown algorithm");
+                if (header.getDictionaryId() != tree->getPresetId() && header.algorithm != ContainerHeader::STATIC)
+                    return fail("the stream was compressed with a dictionary");
+                tree->setRescaleThreshold(static_cast<int>(header.getRescaleThreshold()));
+                table.reset(new DecodeTable<T>(*tree));
+                staticBlocks = header.algorithm == ContainerHeader::STATIC;
+                used += header.size();
+                offset = header.size();
+                state = BLOCKS;
+                return true;
+            }
+            case BLOCKS: {
+                BlockHeader block;
+                if (!block.read(input))
+                    return false;
+                if (block.isEnd()) {
+                    used += BlockHeader::SIZE;
+                    state = TRAILER;
+                    return true;
+                }
+                std::string name = "block " + std::to_string(count);
+                if (block.rawLength > std::uint64_t(header.blockSize) * sizeof(T))
+                    return fail(name + " is larger than the block size");
+                if (size - BlockHeader::SIZE < block.codedLength)
+                    return false;
+                const char* code = pending.data() + used + BlockHeader::SIZE;
+                if (!block.check(code))
+                    return fail(name + " is corrupt (checksum mismatch)");
+                if (header.isIndependent())
+                    tree->reset();
+                std::size_t at = decoded.size();
+                std::uint32_t n = block.getSymbols(sizeof(T));
+                decoded.resize(at + n);
+                bool valid;
+                if (staticBlocks)
+                    valid = staticCode.decodeBlock(code, block.codedLength, decoded.data() + at, n);
+                else
+                    valid = HuffmanDecoder<T>::decodeBlock(*tree, *table, code, block.codedLength, decoded.data() + at, n);
+                if (!valid)
+                    return fail(name + " is corrupt (invalid code)");
+                if (!block.checkData(decoded.data() + at))
+                    return fail(name + " does not decode to the input that was coded (checksum mismatch)");
+                indexCrc = BlockIndexEntry(offset, block.rawLength).addTo(indexCrc);
+                offset += BlockHeader::SIZE + block.codedLength;
+                length += block.rawLength;
+                count++;
+                used += BlockHeader::SIZE + block.codedLength;
+                return true;
+            }
+            case TRAILER: {
+                std::size_t indexSize = header.isIndexed() ? static_cast<std::size_t>(count) * BlockIndexEntry::SIZE : 0;
+                if (size < indexSize + ContainerFooter::SIZE)
+                    return false;
+                ContainerFooter footer;
+                input.seekg(static_cast<std::streamoff>(indexSize));
+                if (!footer.read(input))
+                    return fail("corrupt footer");
+                if (Crc32::compute(pending.data() + used, indexSize) != footer.indexCrc)
+                    return fail("corrupt block index");
+                if (footer.blockCount != count || footer.originalLength != length)
+                    return fail("the blocks do not match the footer");
+                //the index written matches its checksum, which must also be the checksum of the blocks decoded
+                if (footer.indexCrc != (header.isIndexed() ? indexCrc : 0))
+                    return fail("the blocks do not match the index");
+                used += indexSize + ContainerFooter::SIZE;
+                state = DONE;
+                return false;
+            }
+            default:
+                return false;
+        }
+    }
+};
+
+#endif //DATA_ENCODING_P01_STREAMCODER_HPP
@@ -0,0 +1,81 @@
+#ifndef DATA_ENCODING_P01_THREADPOOL_HPP
+#define DATA_ENCODING_P01_THREADPOOL_HPP
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/*
+ * A fixed number of worker threads taking jobs from a shared queue, in the order they were submitted.
+ */
+class ThreadPool {
+public:
+    //start the given number of workers, or one per hardware thread if zero
+    explicit ThreadPool(unsigned threads) : stopping(false) {
+        if (threads == 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned i = 0; i < threads; i++)
+            workers.push_back(std::thread(&ThreadPool::work, this));
+    }
+
+    //finish every job already submitted, then stop the workers
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        ready.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    //queue a job, the future becomes ready once the job has run
+    std::future<void> submit(std::function<void()> job) {
+        std::shared_ptr<std::packaged_task<void()>> task = std::make_shared<std::packaged_task<void()>>(job);
+        std::future<void> done = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push([task]() { (*task)(); });
+        }
+        ready.notify_one();
+        return done;
+    }
+
+    //return the number of workers
+    unsigned size() {
+        return static_cast<unsigned>(workers.size());
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable ready;
+    bool stopping;
+
+    void work() {
+        while (true) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                ready.wait(lock, [this]() { return stopping || !jobs.empty(); });
+                if (jobs.empty())
+                    return;
+                job = std::move(jobs.front());
+                jobs.pop();
+            }
+            job();
+        }
+    }
+};
+
+#endif //DATA_ENCODING_P01_THREADPOOL_HPP
@@ -0,0 +1,140 @@
+#ifndef DATA_ENCODING_P01_VITTERTREE_HPP
+#define DATA_ENCODING_P01_VITTERTREE_HPP
+
+#include "ArrayTree.hpp"
+
+template<typename T> class VitterTree : public ArrayTree<T> {
+    typedef typename ArrayTree<T>::index_t index_t;
+    using ArrayTree<T>::weight;
+    using ArrayTree<T>::parent;
+    using ArrayTree<T>::child;
+    using ArrayTree<T>::symbol;
+    using ArrayTree<T>::leaf;
+    using ArrayTree<T>::nyt;
+    using ArrayTree<T>::newNode;
+    using ArrayTree<T>::swapNodes;
+    using ArrayTree<T>::incrementWeight;
+    using ArrayTree<T>::adopt;
+    using ArrayTree<T>::touch;
+    using ArrayTree<T>::invalidateCodes;
+    using ArrayTree<T>::getBlockLeader;
+    using ArrayTree<T>::getKeyAbove;
+    using ArrayTree<T>::leaveBlock;
+    using ArrayTree<T>::joinBlock;
+    using ArrayTree<T>::shiftBlockDown;
+    using ArrayTree<T>::getRootIndex;
+    using ArrayTree<T>::NO_NODE;
+    using ArrayTree<T>::needsRescale;
+    /*
+     * Update procedure derived from Algorithm Lambda,
+     * Vitter, J. S. (1987). Design and analysis of dynamic Huffman codes. Journal of the ACM, 34(4), p825-845
+     *
+     * Vitter's invariant: nodes are numbered in order of weight, and among nodes of equal weight the leaves come before
+     * the internal nodes. Of all the trees with minimal cost this keeps the smallest total (and maximum) path length.
+     *
+     * Some pseudo-code to help understand the process:
+     *
+     * Slide And Increment Procedure (for node p):
+     * - swap p with the leader of its block
+     * - IF (p is a leaf AND the next block up holds the internal nodes of p's weight) OR
+     * -    (p is internal AND the next block up holds the leaves of p's weight + 1)
+     * -     slide p above the nodes in that block, swapping it with the block's leader
+     * - increment p's weight
+     * - IF p is a leaf
+     * -     go to p's new parent
+     * - ELSE
+     * -     go to p's former parent
+     * - END
+     *
+     * Update Procedure:
+     * - IF first appearance of symbol
+     * -     NYT gives birth to new NYT on left, and an external node on the right using the symbol, all of weight 0
+     * -     leaf to increment = the new external node
+     * -     go to the old NYT node
+     * - ELSE
+     * -     swap symbol's external node with the leader of its block
+     * -     IF the external node is the sibling of NYT
+     * -         leaf to increment = the external node
+     * -         go to the parent node
+     * - WHILE not past the root
+     * -     CALL Slide And Increment Procedure
+     * - IF there is a leaf to increment
+     * -     CALL Slide And Increment Procedure on it
+     * - END
+     */
+public:
+    VitterTree() : ArrayTree<T>() {
+        this->reset();
+    }
+
+    virtual HuffmanTree<T>* clone() override {
+        return new VitterTree<T>(*this);
+    }
+
+    virtual void update(T c) override {
+        index_t q, leafToIncrement = NO_NODE;
+        //if this is the first appearance of symbol
+        if (leaf[c] == NO_NODE) {
+            q = newNode(c);
+            leafToIncrement = q - 1;
+        } else {
+            q = getBlockLeader(leaf[c]);
+            if (q != leaf[c])
+                swapNodes(leaf[c], q);
+            if (nyt != getRootIndex() && parent[q] == parent[nyt]) {
+                leafToIncrement = q;
+                q = parent[q];
+            }
+        }
+        while (q != NO_NODE)
+            q = slideAndIncrement(q);
+        if (leafToIncrement != NO_NODE)
+            slideAndIncrement(leafToIncrement);
+        if (needsRescale())
+            this->rescale();
+    }
+
+protected:
+    //leaves come before internal nodes of the same weight, so each weight has a block of each kind
+    virtual long getKey(index_t node) override {
+        return 2L * weight[node] + (child[node] == NO_NODE ? 0 : 1);
+    }
+
+    virtual bool leavesFirst() override {
+        return true;
+    }
+
+private:
+    //slide and increment the node, once it leads its block. returns the node whose weight should be incremented next
+    index_t slideAndIncrement(index_t p) {
+        index_t leader = getBlockLeader(p);
+        if (leader != p) {
+            swapNodes(p, leader);
+            p = leader;
+        }
+        bool isLeaf = child[p] == NO_NODE;
+        index_t formerParent = parent[p];
+        //the block to slide over has a key one lower than the node will have after being incremented
+        if (getKeyAbove(p) == getKey(p) + 1) {
+            leaveBlock(p);
+            index_t top = shiftBlockDown(p);
+            slide(p, top);
+            p = top;
+            weight[p]++;
+            joinBlock(p, getKey(p));
+        } else
+            incrementWeight(p);
+        return isLeaf ? parent[p] : formerParent;
+    }
+
+    //move the contents of node p (the symbol or the subtree) up to node top, and the contents of top down to p. the nodes
+    //between them keep their contents: they all have the same weight and kind as top, so Vitter's invariant holds
+    //whichever of them is at p, and the swap takes the same time however big the block is. the nodes keep their parents,
+    //so the moved contents are now held in different places in the tree
+    void slide(index_t p, index_t top) {
+        std::swap(weight[p], weight[top]);
+        swapNodes(p, top);
+    }
+};
+
+#endif //DATA_ENCODING_P01_VITTERTREE_HPP
@@ -1,9 +1,17 @@
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <cmath>
+#include <memory>
 #include "FGKTree.hpp"
+#include "ArrayFGKTree.hpp"
+#include "VitterTree.hpp"
 #include "HuffmanEncoder.hpp"
 #include "HuffmanDecoder.hpp"
+#include "Dictionary.hpp"
+#include "ThreadPool.hpp"
+#include "MappedInput.hpp"
+#include "AsyncStream.hpp"
 
 
 /*
@@ -18,30 +26,93 @@
 
 
 
-static std::string INPUT = "", OUTPUT = "";
-static bool HELP = false, DECOMPRESS = false, REPORT = false;
+static std::string INPUT = "", OUTPUT = "", BACKEND = "node", ALGORITHM = "fgk", MODE = "adaptive", DICTIONARY = "";
+static bool HELP = false, DECOMPRESS = false, TRAIN = false, REPORT = false, INDEPENDENT = false;
+static unsigned THREADS = 1, SYMBOL_BITS = CHAR_BIT;
+static std::uint32_t BLOCK_SIZE = ContainerHeader::DEFAULT_BLOCK_SIZE, RESCALE_THRESHOLD = 0;
+static bool RANGE = false, STATS = false, STATS_JSON = false;
+static std::uint64_t RANGE_OFFSET = 0, RANGE_LENGTH = 0;
+//where progress messages go, which is standard error when the output is standard output
+static std::ostream* LOG = &std::cout;
+//where --stats prints the counters, the JSON being kept apart from the progress messages so that it can be parsed
+static std::ostream* STATS_LOG = &std::cout;
+//a stream with no buffer, which drops whatever is written to it
+static std::ostream NO_LOG(nullptr);
 static const std::string USAGE =
-        "USAGE: huff [--puff] [-h|--help] <input-file> <output-file>\n"
-        "<input-file>   the file treated as input\n"
-        "<output-file>  the file treated as output (will overwrite if already exists)\n"
-        "--puff         Tells huff to decompress the input file. Huff will compress files by default.\n"
-        "-h|--help      Print this usage screen.\n"
-        "-r|--report    Produce a report at the end, detailing the level of compression achieved, most common symbol etc..";
+        "USAGE: huff [--puff|--train] [-h|--help] [--mode=adaptive|static] [--algorithm=fgk|vitter] [--backend=node|array]\n"
+        "            [--independent] [-j N] [--block-size=N] [--symbol-bits=8|16] [--rescale=N]\n"
+        "            [--dict FILE] [--range=OFFSET:LEN] [--stats[=json]] <input-file> <output-file>\n"
+        "<input-file>     the file treated as input, or - for standard input\n"
+        "<output-file>    the file treated as output (will overwrite if already exists), or - for standard output\n"
+        "--puff           Tells huff to decompress the input file. Huff will compress files by default.\n"
+        "--train          Count the symbols of the input file, a sample of the data to be compressed, and write them to the\n"
+        "                 output file as a dictionary for --dict.\n"
+        "-h|--help        Print this usage screen.\n"
+        "-r|--report      Produce a report at the end, detailing the level of compression achieved, most common symbol etc..\n"
+        "--mode=...       Code with an adaptive Huffman tree (adaptive, the default), or count each block's symbols first\n"
+        "                 and code them with a static canonical Huffman code (static). Static coding is much faster, and\n"
+        "                 compresses about as well on large files; its blocks are always independent. The mode is recorded\n"
+        "                 in the compressed file, so it does not need to be given to decompress.\n"
+        "--algorithm=...  The adaptive Huffman algorithm: FGK (fgk, the default) or Vitter's algorithm (vitter).\n"
+        "                 Vitter's algorithm gives shorter codes, and uses the array backend. The algorithm is recorded in\n"
+        "                 the compressed file, so it does not need to be given to decompress.\n"
+        "--backend=...    How the code tree is stored: linked nodes (node, the default) or flat arrays (array).\n"
+        "                 Both produce the same output.\n"
+        "--independent    Compress each block of the input with a new code tree, rather than carrying the tree on from one\n"
+        "                 block to the next. This costs a little compression, but lets the blocks be compressed in parallel.\n"
+        "-j N             Compress N blocks at once on N threads (0 for one per core), implies --independent. With --puff,\n"
+        "                 decompress N blocks at once if they were compressed independently.\n"
+        "--block-size=N   The number of bytes in each block (1048576 by default).\n"
+        "--symbol-bits=.. The size of the symbols coded: bytes (8, the default) or pairs of bytes (16). Pairs suit inputs\n"
+        "                 made of 16-bit values, such as uncompressed audio. The size is recorded in the compressed file.\n"
+        "--rescale=N      Halve every weight in the code tree whenever the symbols it has counted pass N, so that the\n"
+        "                 code follows the recent data rather than the whole input. This suits inputs whose statistics\n"
+        "                 drift, such as concatenated logs. N must be at least twice the number of possible symbols (512\n"
+        "                 for bytes, 131072 with --symbol-bits=16), so that the tree is not rebuilt too often. 0 (the\n"
+        "                 default) never rescales. The threshold is recorded in the compressed file.\n"
+        "--dict FILE      Start the code tree from the dictionary made by --train, rather than from nothing, so that the\n"
+        "                 symbols common in the sample are coded well from the start. This helps most with small files.\n"
+        "                 The same dictionary must be given to decompress.\n"
+        "--range=OFFSET:LEN\n"
+        "                 With --puff, decompress only the LEN bytes starting at byte OFFSET. If the blocks were compressed\n"
+        "                 independently, decompression starts at the block holding OFFSET rather than the start of the file.\n"
+        "--stats[=json]   Count the symbols coded, NYT escapes, tree swaps, average code length and tree depth, and time\n"
+        "                 the tree updates, bit I/O and stream I/O, then print them as a table (or as JSON) to the log.\n"
+        "                 The JSON is printed alone to standard output, the log going to standard error instead (or to\n"
+        "                 standard error, with no log, if the output is standard output). Only available if huff was\n"
+        "                 built with -DHUFF_STATS=ON.";
 
 // parse command line arguments and react to them
 static void parseArgs(int argc, char* argv[]);
 
+// create the code tree for the algorithm id (see ContainerHeader), starting from the dictionary if one was given
+template<typename T> static HuffmanTree<T>* makeTree(unsigned char algorithm);
+
+// return the dictionary given with --dict, which is read the first time. exits if it is not a dictionary for symbols of
+// type T
+template<typename T> static const Dictionary<T>& getDictionary();
+
+// counts the symbols of the input file, outputting them as a dictionary to the output file
+template<typename T> static int train(std::istream& input, std::ostream& output);
+
 // create a report on how much compression has been reached, as well as some information about the final code-tree
-static void reportCompression(std::string uncompressed, std::string compressed, HuffmanTree<unsigned char>& finalTree);
+// (if there is a single final tree)
+template<typename T> static void reportCompression(std::string uncompressed, std::string compressed, HuffmanTree<T>* finalTree);
 
 //return the file size in bytes
 static long getFileSize(std::string file);
 
 // encodes the input file, outputting to the output file
-static int encode(std::ifstream& input, std::ofstream& output, HuffmanTree<unsigned char>& tree);
+template<typename T> static int encode(std::istream& input, std::ostream& output, std::unique_ptr<HuffmanTree<T>>& tree);
+
+// decodes the input file, outputting to the output file. the code tree, and whether it is left in tree or wideTree, is
+// chosen by the input's header
+static int decode(std::istream& input, std::ostream& output, std::unique_ptr<HuffmanTree<unsigned char>>& tree,
+                  std::unique_ptr<HuffmanTree<std::uint16_t>>& wideTree);
 
-// decodes the input file, outputting to the output file
-static int decode(std::ifstream& input, std::ofstream& output, HuffmanTree<unsigned char>& tree);
+// decodes the blocks after the header with symbols of type T
+template<typename T> static int decodeBlocks(std::istream& input, std::ostream& output, const ContainerHeader& header,
+                                             std::unique_ptr<HuffmanTree<T>>& tree);
 
 
 
@@ -51,7 +122,9 @@ static int decode(std::ifstream& input, std::ofstream& output, HuffmanTree<unsig
 
 int main(int argc, char* argv[]) {
     parseArgs(argc, argv);
-    FGKTree<unsigned char> tree = FGKTree<unsigned char>();
+    //the final tree, which codes 16-bit symbols if the input is coded as such
+    std::unique_ptr<HuffmanTree<unsigned char>> tree;
+    std::unique_ptr<HuffmanTree<std::uint16_t>> wideTree;
 
     //check if help was requested, exit early if so
     if (HELP) {
@@ -59,19 +132,39 @@ int main(int argc, char* argv[]) {
         return 0;
     }
 
-    std::ifstream input;
-    std::ofstream output;
-    input.open(INPUT, std::ios::in | std::ios::binary);
-    output.open(OUTPUT, std::ios::out | std::ios::binary);
+    //regular files are mapped into memory and coded where they lie, anything else (such as a pipe) is read as a stream.
+    //standard input and output are read ahead and written behind on threads of their own
+    std::unique_ptr<MappedInput> mapped(INPUT == "-" ? nullptr : new MappedInput(INPUT));
+    std::unique_ptr<std::istream> stream;
+    if (INPUT == "-")
+        stream.reset(new AsyncInput());
+    else if (!mapped->isOpen())
+        stream.reset(new std::ifstream(INPUT, std::ios::in | std::ios::binary));
+    std::istream& input = stream ? *stream : *mapped;
+    std::unique_ptr<std::ostream> output(OUTPUT == "-" ? static_cast<std::ostream*>(new AsyncOutput())
+                                                       : new std::ofstream(OUTPUT, std::ios::out | std::ios::binary));
     int exitCode = 0;
     if (DECOMPRESS)
-        exitCode = decode(input, output, tree);
+        exitCode = decode(input, *output, tree, wideTree);
+    else if (TRAIN)
+        exitCode = SYMBOL_BITS == 16 ? train<std::uint16_t>(input, *output) : train<unsigned char>(input, *output);
+    else if (SYMBOL_BITS == 16)
+        exitCode = encode(input, *output, wideTree);
     else
-        exitCode = encode(input, output, tree);
-    input.close();
-    output.close();
-    if (REPORT)
-        reportCompression(INPUT, OUTPUT, tree);
+        exitCode = encode(input, *output, tree);
+    //anything still waiting to be written out is written now, so that a failure can be reported
+    if (exitCode == 0 && !output->flush()) {
+        std::cerr << "failed to write " << OUTPUT << std::endl;
+        exitCode = 1;
+    }
+    stream.reset();
+    output.reset();
+    if (REPORT && wideTree)
+        reportCompression(INPUT, OUTPUT, wideTree.get());
+    else if (REPORT)
+        reportCompression(INPUT, OUTPUT, tree.get());
+    if (STATS)
+        Stats::report(*STATS_LOG, STATS_JSON);
     return exitCode;
 }
 
@@ -81,6 +174,15 @@ int main(int argc, char* argv[]) {
 
 
 
+// parse the value of a numeric option, exiting if it is not a number no larger than max
+static std::uint64_t parseNumber(const std::string& option, const std::string& value, std::uint64_t max = UINT32_MAX) {
+    if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos || value.length() > 18 || std::stoull(value) > max) {
+        std::cerr << "expected a number (up to " << max << ") for " << option << "\n" << USAGE << std::endl;
+        std::exit(1);
+    }
+    return std::stoull(value);
+}
+
 static void parseArgs(int argc, char* argv[]) {
     //read each argument except argv[0]
     for (int i = 1; i < argc; i++) {
@@ -90,8 +192,60 @@ static void parseArgs(int argc, char* argv[]) {
             HELP = true;
         else if (arg == "--puff")
             DECOMPRESS = true;
+        else if (arg == "--train")
+            TRAIN = true;
         else if (arg == "-r" || arg == "--report")
             REPORT = true;
+        else if (arg.compare(0, 7, "--mode=") == 0)
+            MODE = arg.substr(7);
+        else if (arg.compare(0, 12, "--algorithm=") == 0)
+            ALGORITHM = arg.substr(12);
+        else if (arg.compare(0, 10, "--backend=") == 0)
+            BACKEND = arg.substr(10);
+        else if (arg == "--independent")
+            INDEPENDENT = true;
+        else if (arg.compare(0, 2, "-j") == 0) {
+            //the thread count may be given with the option or as the next argument
+            std::string count = arg.length() > 2 ? arg.substr(2) : (i + 1 < argc ? argv[++i] : "");
+            THREADS = static_cast<unsigned>(parseNumber(arg, count));
+            INDEPENDENT = THREADS != 1 || INDEPENDENT;
+        } else if (arg.compare(0, 13, "--block-size=") == 0) {
+            BLOCK_SIZE = static_cast<std::uint32_t>(parseNumber(arg, arg.substr(13)));
+            if (BLOCK_SIZE == 0) {
+                std::cerr << "the block size must be at least 1\n" << USAGE << std::endl;
+                std::exit(1);
+            }
+        } else if (arg.compare(0, 14, "--symbol-bits=") == 0) {
+            SYMBOL_BITS = static_cast<unsigned>(parseNumber(arg, arg.substr(14)));
+            if (SYMBOL_BITS != 8 && SYMBOL_BITS != 16) {
+                std::cerr << "the symbol size must be 8 or 16 bits\n" << USAGE << std::endl;
+                std::exit(1);
+            }
+        } else if (arg == "--dict" || arg.compare(0, 7, "--dict=") == 0) {
+            //the dictionary may be given with the option or as the next argument
+            DICTIONARY = arg.length() > 7 ? arg.substr(7) : (i + 1 < argc ? argv[++i] : "");
+            if (DICTIONARY.empty()) {
+                std::cerr << "expected a file for --dict\n" << USAGE << std::endl;
+                std::exit(1);
+            }
+        } else if (arg.compare(0, 10, "--rescale=") == 0) {
+            RESCALE_THRESHOLD = static_cast<std::uint32_t>(parseNumber(arg, arg.substr(10), INT_MAX));
+        } else if (arg == "--range" || arg.compare(0, 8, "--range=") == 0) {
+            //the range may be given with the option or as the next argument
+            std::string range = arg.length() > 8 ? arg.substr(8) : (i + 1 < argc ? argv[++i] : "");
+            std::size_t colon = range.find(':');
+            RANGE_OFFSET = parseNumber("--range", range.substr(0, colon), UINT64_MAX >> 8);
+            RANGE_LENGTH = parseNumber("--range", colon == std::string::npos ? "" : range.substr(colon + 1), UINT64_MAX >> 8);
+            RANGE = true;
+        } else if (arg == "--stats" || arg == "--stats=json") {
+#ifdef HUFF_STATS
+            STATS = true;
+            STATS_JSON = arg == "--stats=json";
+#else
+            std::cerr << "--stats needs huff to be built with the counters, configure with -DHUFF_STATS=ON" << std::endl;
+            std::exit(1);
+#endif
+        }
         else if (INPUT.empty() || INPUT.length() == 0)
             INPUT = arg;
         else if (OUTPUT.empty() || OUTPUT.length() == 0)
@@ -112,23 +266,110 @@ static void parseArgs(int argc, char* argv[]) {
             std::cerr << "output file not specified!\n" << USAGE << std::endl;
             std::exit(1);
         }
+        if (ALGORITHM != "fgk" && ALGORITHM != "vitter") {
+            std::cerr << "unrecognised algorithm: " << ALGORITHM << "\n" << USAGE << std::endl;
+            std::exit(1);
+        }
+        if (MODE != "adaptive" && MODE != "static") {
+            std::cerr << "unrecognised mode: " << MODE << "\n" << USAGE << std::endl;
+            std::exit(1);
+        }
+        if (BACKEND != "node" && BACKEND != "array") {
+            std::cerr << "unrecognised backend: " << BACKEND << "\n" << USAGE << std::endl;
+            std::exit(1);
+        }
+        if (OUTPUT == "-")
+            LOG = &std::cerr;
+        STATS_LOG = LOG;
+        //the JSON has standard output to itself, or standard error if the output is written there
+        if (STATS_JSON) {
+            STATS_LOG = OUTPUT == "-" ? &std::cerr : &std::cout;
+            LOG = OUTPUT == "-" ? &NO_LOG : &std::cerr;
+        }
+        if (RANGE && !DECOMPRESS) {
+            std::cerr << "--range can only be used with --puff\n" << USAGE << std::endl;
+            std::exit(1);
+        }
+        if (RESCALE_THRESHOLD != 0 && RESCALE_THRESHOLD < ContainerHeader::minRescaleThreshold(SYMBOL_BITS)) {
+            std::cerr << "the rescale threshold must be at least " << ContainerHeader::minRescaleThreshold(SYMBOL_BITS)
+                      << " for " << SYMBOL_BITS << "-bit symbols\n" << USAGE << std::endl;
+            std::exit(1);
+        }
+        if (TRAIN && (DECOMPRESS || !DICTIONARY.empty())) {
+            std::cerr << "--train cannot be used with --puff or --dict\n" << USAGE << std::endl;
+            std::exit(1);
+        }
+    }
+}
+
+template<typename T> static HuffmanTree<T>* makeTree(unsigned char algorithm) {
+    HuffmanTree<T>* tree;
+    //Vitter's algorithm is only implemented over flat arrays
+    if (algorithm == ContainerHeader::VITTER)
+        tree = new VitterTree<T>();
+    else if (BACKEND == "array")
+        tree = new ArrayFGKTree<T>();
+    else
+        tree = new FGKTree<T>();
+    if (!DICTIONARY.empty())
+        tree->setPreset(getDictionary<T>().getWeights(), getDictionary<T>().getId());
+    return tree;
+}
+
+template<typename T> static const Dictionary<T>& getDictionary() {
+    //made once, even when trees are made on several threads
+    static const Dictionary<T> dictionary = []() {
+        Dictionary<T> read;
+        std::ifstream file(DICTIONARY, std::ios::in | std::ios::binary);
+        if (!file) {
+            std::cerr << "failed to read " << DICTIONARY << std::endl;
+            std::exit(1);
+        } else if (!read.read(file)) {
+            std::cerr << DICTIONARY << " is not a dictionary of " << sizeof(T) * CHAR_BIT << "-bit symbols, or is corrupt"
+                      << std::endl;
+            std::exit(1);
+        }
+        return read;
+    }();
+    return dictionary;
+}
+
+template<typename T> static int train(std::istream& input, std::ostream& output) {
+    *LOG << "training..." << std::endl;
+    if (!input.good()) {
+        std::cerr << "failed to read " << INPUT << std::endl;
+        return 1;
+    } else if (!output.good()) {
+        std::cerr << "failed to find / write to " << OUTPUT << std::endl;
+        return 1;
     }
+    //the input is counted a block at a time, any byte left over from the last symbol being dropped
+    Dictionary<T> dictionary;
+    std::vector<T> buffer(ContainerHeader::DEFAULT_BLOCK_SIZE);
+    while (input.read(reinterpret_cast<char*>(buffer.data()), buffer.size() * sizeof(T)) || input.gcount() > 0)
+        dictionary.train(buffer.data(), static_cast<std::size_t>(input.gcount()) / sizeof(T));
+    if (input.bad()) {
+        std::cerr << "failed to read " << INPUT << std::endl;
+        return 1;
+    } else if (dictionary.empty()) {
+        std::cerr << INPUT << " has no symbols to train on" << std::endl;
+        return 1;
+    }
+    dictionary.write(output);
+    *LOG << "trained " << INPUT << " into " << OUTPUT << std::endl;
+    return 0;
 }
 
-static void reportCompression(std::string inputFile, std::string outputFile, HuffmanTree<unsigned char>& finalTree) {
+template<typename T> static void reportCompression(std::string inputFile, std::string outputFile, HuffmanTree<T>* finalTree) {
     //provide report about the level of compression and the tree
     long inputSize = getFileSize(inputFile);
     long outputSize = getFileSize(outputFile);
-    unsigned char mostCommonSymbol = 0;
-
-    unsigned long maxI = 0, minI = 0;
-    auto indices = finalTree.getIndices();
-    for (auto pair : finalTree.getIndices()) {
-        auto node = pair.first;
-        if (node->isLeaf() && node != finalTree.getNYTNode() && indices[node] > maxI) {
-            maxI = indices[node];
-            mostCommonSymbol = node->getElement().value.value();
-        }
+    T mostCommonSymbol = 0;
+
+    //the leaf with the highest number also has the highest weight
+    for (unsigned long node = finalTree ? finalTree->getNYTIndex() + 1 : 1; finalTree && node <= finalTree->getRootIndex(); node++) {
+        if (finalTree->isLeaf(node))
+            mostCommonSymbol = finalTree->getSymbol(node);
     }
 
     double ratio;
@@ -136,14 +377,23 @@ static void reportCompression(std::string inputFile, std::string outputFile, Huf
         ratio = -1;
     else
         ratio = (double)1 - round(100 * (DECOMPRESS ? (double)inputSize / (double)outputSize : (double)outputSize / (double)inputSize)) / 100;
-    std::cout << "input file size    : " << (inputSize != -1 ? std::to_string(inputSize) : "failed to determine size") << (DECOMPRESS ? " (compressed)" : "") << "\n";
-    std::cout << "output file size   : " << (outputSize != -1 ? std::to_string(outputSize) : "failed to determine size") << (DECOMPRESS ? "" : " (compressed)") << "\n";
-    std::cout << "compression ratio  : " << (ratio == -1 ? "could not determine ratio" : std::to_string(ratio)) << "\n";
-    std::cout << "final node count   : " << indices.size() << "\n";
-    std::cout << "most common symbol : " << std::hex << "0x" << +mostCommonSymbol << " \"" << mostCommonSymbol << "\"" << "\n";
+    *LOG << "input file size    : " << (inputSize != -1 ? std::to_string(inputSize) : "failed to determine size") << (DECOMPRESS ? " (compressed)" : "") << "\n";
+    *LOG << "output file size   : " << (outputSize != -1 ? std::to_string(outputSize) : "failed to determine size") << (DECOMPRESS ? "" : " (compressed)") << "\n";
+    *LOG << "compression ratio  : " << (ratio == -1 ? "could not determine ratio" : std::to_string(ratio)) << "\n";
+    if (finalTree == nullptr)
+        return;
+    *LOG << "final node count   : " << finalTree->getNodeCount() << "\n";
+    //a symbol wider than a byte has no character to show
+    *LOG << "most common symbol : " << std::hex << "0x" << +mostCommonSymbol;
+    if (sizeof(T) == 1)
+        *LOG << " \"" << mostCommonSymbol << "\"";
+    *LOG << "\n";
 }
 
 static long getFileSize(std::string file) {
+    //standard input and output have no size to find
+    if (file == "-")
+        return -1;
     std::ifstream f;
     f.open(file, std::ifstream::ate | std::ifstream::binary);
     auto size = f.tellg();
@@ -151,24 +401,55 @@ static long getFileSize(std::string file) {
     return size;
 }
 
-static int encode(std::ifstream& input, std::ofstream& output, HuffmanTree<unsigned char>& tree) {
-    std::cout << "compressing..." << std::endl;
-    HuffmanEncoder<unsigned char> encoder = HuffmanEncoder<unsigned char>(input, output, tree);
-    if (!output.good()) {
+template<typename T> static int encode(std::istream& input, std::ostream& output, std::unique_ptr<HuffmanTree<T>>& tree) {
+    *LOG << "compressing..." << std::endl;
+    //the block size is given in bytes, but recorded in symbols
+    unsigned char algorithm = ALGORITHM == "vitter" ? ContainerHeader::VITTER : ContainerHeader::FGK;
+    ContainerHeader header(MODE == "static" ? ContainerHeader::STATIC : algorithm, sizeof(T) * CHAR_BIT,
+                           std::max<std::uint32_t>(1, BLOCK_SIZE / sizeof(T)));
+    if (INDEPENDENT || MODE == "static")
+        header.flags |= ContainerHeader::INDEPENDENT;
+    if (RESCALE_THRESHOLD != 0 && MODE != "static") {
+        header.flags |= ContainerHeader::RESCALE;
+        header.rescaleThreshold = RESCALE_THRESHOLD;
+    }
+    if (!DICTIONARY.empty() && MODE != "static") {
+        header.flags |= ContainerHeader::DICTIONARY;
+        header.dictionaryId = getDictionary<T>().getId();
+    }
+    if (!input.good()) {
+        std::cerr << "failed to read " << INPUT << std::endl;
+        return 1;
+    } else if (!output.good()) {
         std::cerr << "failed to find / write to " << OUTPUT << std::endl;
         return 1;
+    } else if (THREADS != 1) {
+        //each block has its own tree, so there is no single final tree to report on, and the encoder's own tree is unused
+        ThreadPool pool(THREADS);
+        std::unique_ptr<HuffmanTree<T>> unused(makeTree<T>(header.algorithm));
+        HuffmanEncoder<T> encoder(input, output, *unused);
+        encoder.encode(header, pool, [&header]() { return makeTree<T>(header.algorithm); });
     } else {
-        // peek() will cause good() to return false if the EOF is reached for instance
-        if (input.peek(), input.good())
-            encoder.encode();
-        std::cout << "compressed " << INPUT << " into " << OUTPUT << std::endl;
-        return 0;
+        //with the STATIC algorithm each block has its own code, so the tree is unused and there is none to report on
+        std::unique_ptr<HuffmanTree<T>> unused;
+        std::unique_ptr<HuffmanTree<T>>& kept = header.algorithm == ContainerHeader::STATIC ? unused : tree;
+        kept.reset(makeTree<T>(header.algorithm));
+        HuffmanEncoder<T> encoder(input, output, *kept);
+        encoder.encode(header);
     }
+    //a read which failed part way looks like the end of the input to the encoder
+    if (input.bad()) {
+        std::cerr << "failed to read " << INPUT << std::endl;
+        return 1;
+    }
+    *LOG << "compressed " << INPUT << " into " << OUTPUT << std::endl;
+    return 0;
 }
 
-static int decode(std::ifstream& input, std::ofstream& output, HuffmanTree<unsigned char>& tree) {
-    std::cout << "decompressing..." << std::endl;
-    HuffmanDecoder<unsigned char> decoder = HuffmanDecoder<unsigned char>(input, output, tree);
+static int decode(std::istream& input, std::ostream& output, std::unique_ptr<HuffmanTree<unsigned char>>& tree,
+                  std::unique_ptr<HuffmanTree<std::uint16_t>>& wideTree) {
+    *LOG << "decompressing..." << std::endl;
+    ContainerHeader header;
     // peek() will cause good() to return false if the EOF is reached for instance
     if (!(input.peek(), input.good())) {
         std::cerr << "failed to read " << INPUT << std::endl;
@@ -176,10 +457,57 @@ static int decode(std::ifstream& input, std::ofstream& output, HuffmanTree<unsig
     } else if (!output.good()) {
         std::cerr << "failed to find / write to " << OUTPUT << std::endl;
         return 1;
+    } else if (!header.read(input)) {
+        std::cerr << INPUT << " is not a huff file" << std::endl;
+        return 1;
+    } else if (header.algorithm != ContainerHeader::FGK && header.algorithm != ContainerHeader::VITTER &&
+               header.algorithm != ContainerHeader::STATIC) {
+        std::cerr << INPUT << " uses an unknown algorithm" << std::endl;
+        return 1;
+    }
+    //any other symbol size is reported by the decoder
+    if (header.symbolBits == 16)
+        return decodeBlocks(input, output, header, wideTree);
+    return decodeBlocks(input, output, header, tree);
+}
+
+template<typename T> static int decodeBlocks(std::istream& input, std::ostream& output, const ContainerHeader& header,
+                                             std::unique_ptr<HuffmanTree<T>>& tree) {
+    //with the STATIC algorithm each block has its own code, so the tree is unused and there is none to report on
+    std::unique_ptr<HuffmanTree<T>> unused;
+    std::unique_ptr<HuffmanTree<T>>& kept = header.algorithm == ContainerHeader::STATIC ? unused : tree;
+    bool decoded;
+    if (RANGE) {
+        //only the blocks overlapping the range are decoded, which needs the index from the end of the input
+        if (input.tellg() == std::streampos(-1)) {
+            std::cerr << "--range needs a seekable input" << std::endl;
+            return 1;
+        }
+        kept.reset(makeTree<T>(header.algorithm));
+        HuffmanDecoder<T> decoder(input, output, *kept);
+        decoded = decoder.decodeRange(header, RANGE_OFFSET, RANGE_LENGTH);
+        if (!decoded)
+            std::cerr << "failed to decompress " << INPUT << ": " << decoder.getError() << std::endl;
+    } else if (THREADS != 1 && header.isIndependent() && header.isIndexed() && input.tellg() != std::streampos(-1) && OUTPUT != "-") {
+        //blocks can only be decoded in parallel if they are independent, can be found in the input, and can be written
+        //to any part of the output
+        //each worker writes its blocks straight into the output file, the stream opened for it is left empty
+        ThreadPool pool(THREADS);
+        MappedSliceOutput slices(OUTPUT);
+        unused.reset(makeTree<T>(header.algorithm));
+        HuffmanDecoder<T> decoder(input, output, *unused);
+        decoded = decoder.decode(header, pool, [&header]() { return makeTree<T>(header.algorithm); }, slices);
+        if (!decoded)
+            std::cerr << "failed to decompress " << INPUT << ": " << decoder.getError() << std::endl;
     } else {
-        //decode everything
-        decoder.decode();
-        std::cout << "decompressed " << INPUT << " into " << OUTPUT << std::endl;
-        return 0;
+        kept.reset(makeTree<T>(header.algorithm));
+        HuffmanDecoder<T> decoder(input, output, *kept);
+        decoded = decoder.decode(header);
+        if (!decoded)
+            std::cerr << "failed to decompress " << INPUT << ": " << decoder.getError() << std::endl;
     }
+    if (!decoded)
+        return 1;
+    *LOG << "decompressed " << INPUT << " into " << OUTPUT << std::endl;
+    return 0;
 }
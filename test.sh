@@ -1,11 +1,16 @@
 N=$1
+MODES="default vitter array independent parallel static rescale dict pipe range corrupt"
 
 mkdir -p logs
 
 for i in `seq 1 $N`;
 do
 	echo "running test sequence ${i}"
-	./testset.sh tar tar 2>&1 | tee  --append "logs/run${i}.log"
-	./testset.sh txt txt 2>&1 | tee --append "logs/run${i}.log"
-	./testset.sh img bmp 2>&1 | tee --append "logs/run${i}.log"
+	for mode in $MODES;
+	do
+		./testset.sh tar tar $mode 2>&1 | tee  --append "logs/run${i}.log"
+		./testset.sh txt txt $mode 2>&1 | tee --append "logs/run${i}.log"
+		./testset.sh img bmp $mode 2>&1 | tee --append "logs/run${i}.log"
+	done
+	./testset.sh sound wav wide 2>&1 | tee --append "logs/run${i}.log"
 done
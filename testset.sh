@@ -1,42 +1,128 @@
 #Test the image files, note their compression and compression time etc.
+#usage: ./testset.sh <directory> <extension> [mode], the mode picking the options tested (default when not given):
+#  default      the default options
+#  vitter       --algorithm=vitter
+#  array        --backend=array
+#  independent  --independent, with small blocks
+#  parallel     -j 4 when compressing and decompressing, with small blocks
+#  static       --mode=static
+#  wide         --symbol-bits=16
+#  rescale      --rescale, low enough that the trees are rescaled often
+#  dict         --dict, with a dictionary trained on the first file
+#  pipe         standard input and output in place of the files
+#  range        --range over the middle third of each file, the blocks being independent
+#  corrupt      a byte of each compressed file changed, and then the file truncated, each of which must fail to decompress
 
 RES=$1
 TYPE=$2
+MODE=${3:-default}
+HUFF=${HUFF:-./huff}
 
-echo "Running $TYPE tests from $RES"
+OPTIONS=()
+PUFF_OPTIONS=()
+case "$MODE" in
+	default|pipe|corrupt) ;;
+	vitter) OPTIONS=(--algorithm=vitter) ;;
+	array) OPTIONS=(--backend=array) ;;
+	independent) OPTIONS=(--independent --block-size=65536) ;;
+	parallel) OPTIONS=(-j 4 --block-size=65536); PUFF_OPTIONS=(-j 4) ;;
+	static) OPTIONS=(--mode=static --block-size=65536) ;;
+	wide) OPTIONS=(--symbol-bits=16) ;;
+	rescale) OPTIONS=(--rescale=1024) ;;
+	range) OPTIONS=(--independent --block-size=4096) ;;
+	dict)
+		mkdir -p "${RES}/encoded"
+		DICT="${RES}/encoded/${TYPE}.dict"
+		SAMPLE=$(ls ${RES}/*.${TYPE} | head -n 1)
+		$HUFF --train "$SAMPLE" "$DICT" > /dev/null || { echo "fail training on ${SAMPLE}"; exit 1; }
+		OPTIONS=(--dict "$DICT"); PUFF_OPTIONS=(--dict "$DICT") ;;
+	*) echo "unknown mode ${MODE}"; exit 1 ;;
+esac
+
+echo "Running $TYPE tests from $RES ($MODE)"
 mkdir -p "${RES}/decoded"
 mkdir -p "${RES}/encoded"
 
+FAILED=0
 OUT=""
 for file in ${RES}/*.${TYPE}
 do
 	file=${file##*/}
+	ENCODED="${RES}/encoded/${file}.hff"
+	DECODED="${RES}/decoded/$file"
 
 	# compress, then decompress, collecting output each time
 	T_COMPRESS_START=$(date +"%s.%N")
-	OUT+=$(./huff -r "${RES}/$file" "${RES}/encoded/${file}.hff")
+	if [ "$MODE" == "pipe" ]
+	then
+		OUT+=$($HUFF -r "${OPTIONS[@]}" - - < "${RES}/$file" 2>&1 > "$ENCODED")
+	else
+		OUT+=$($HUFF -r "${OPTIONS[@]}" "${RES}/$file" "$ENCODED")
+	fi
 	T_COMPRESS_END=$(date +"%s.%N")
 	OUT+='\n'
 	T_DECOMPRESS_START=$(date +"%s.%N")
-	OUT+=$(./huff --puff -r "${RES}/encoded/${file}.hff" "${RES}/decoded/$file")
+	if [ "$MODE" == "pipe" ]
+	then
+		OUT+=$($HUFF --puff -r "${PUFF_OPTIONS[@]}" - - < "$ENCODED" 2>&1 > "$DECODED")
+	else
+		OUT+=$($HUFF --puff -r "${PUFF_OPTIONS[@]}" "$ENCODED" "$DECODED")
+	fi
 	T_DECOMPRESS_END=$(date +"%s.%N")
 	OUT+='\n'
 
 	#Calculate time taken to compress and decompress, also the total time
 	T_COMPRESS_TOTAL=$(echo "$T_COMPRESS_END - $T_COMPRESS_START" | bc)
-	T_DECOMPRESS_TOTAL=$(echo "$T_DECOMPRESS_END - $T_COMPRESS_START" | bc)
+	T_DECOMPRESS_TOTAL=$(echo "$T_DECOMPRESS_END - $T_DECOMPRESS_START" | bc)
 	T_TOTAL=$(echo "$T_COMPRESS_TOTAL + $T_DECOMPRESS_TOTAL" | bc)
 
 	# check if the decompressed output is the same as the initial input
-	DIFF=$(diff "${RES}/$file" "${RES}/decoded/$file")
+	DIFF=$(cmp "${RES}/$file" "$DECODED" 2>&1)
 	if [ "$DIFF" != "" ]
 	then
 		echo "fail ${file} in ${T_TOTAL}:"
-		cmp "${RES}/$file" "${RES}/decoded/$file"
-	else
-		echo "pass $file | compressed in ${T_COMPRESS_TOTAL}, decompressed in ${T_DECOMPRESS_TOTAL}"
+		echo "$DIFF"
+		FAILED=1
+		continue
+	fi
+
+	SIZE=$(stat -c %s "${RES}/$file")
+	if [ "$MODE" == "range" ]
+	then
+		# decompress only the middle third, which should match the same bytes of the input
+		OFFSET=$((SIZE / 3))
+		LENGTH=$((SIZE / 3))
+		$HUFF --puff --range=${OFFSET}:${LENGTH} "$ENCODED" "${DECODED}.range" > /dev/null
+		if ! tail -c +$((OFFSET + 1)) "${RES}/$file" | head -c $LENGTH | cmp -s - "${DECODED}.range"
+		then
+			echo "fail ${file}: range ${OFFSET}:${LENGTH} differs"
+			FAILED=1
+			continue
+		fi
+	elif [ "$MODE" == "corrupt" ]
+	then
+		# change a byte in the middle of the compressed file, then cut the last byte off, neither should decompress
+		ENCODED_SIZE=$(stat -c %s "$ENCODED")
+		AT=$((ENCODED_SIZE / 2))
+		BYTE=$(od -An -tu1 -j $AT -N 1 "$ENCODED" | tr -d ' ')
+		cp "$ENCODED" "${ENCODED}.bad"
+		printf "\\$(printf %o $((BYTE ^ 0x55)))" | dd of="${ENCODED}.bad" bs=1 seek=$AT conv=notrunc 2> /dev/null
+		head -c $((ENCODED_SIZE - 1)) "$ENCODED" > "${ENCODED}.short"
+		if $HUFF --puff "${ENCODED}.bad" "${DECODED}.bad" > /dev/null 2>&1
+		then
+			echo "fail ${file}: a changed byte at ${AT} was not detected"
+			FAILED=1
+			continue
+		elif $HUFF --puff "${ENCODED}.short" "${DECODED}.short" > /dev/null 2>&1
+		then
+			echo "fail ${file}: truncation was not detected"
+			FAILED=1
+			continue
+		fi
 	fi
+	echo "pass $file | compressed in ${T_COMPRESS_TOTAL}, decompressed in ${T_DECOMPRESS_TOTAL}"
 done
 
 echo -e "---------------------------\n" >> "${RES}/${TYPE}_test.log"
 echo -e "$OUT" >> "${RES}/${TYPE}_test.log"
+exit $FAILED